@@ -0,0 +1,301 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <canonical.h>
+#include <columns.h>
+#include <document.h>
+#include <loader.h>
+#include <parallel.h>
+#include <parser.h>
+
+/*!
+ * \brief Policy file with `count` instructions of mixed types
+ */
+static pol::PolicyFile makeFile(size_t count)
+{
+    pol::PolicyFile file;
+
+    for (size_t i = 0; i < count; ++i) {
+        pol::PolicyInstruction instruction;
+        instruction.key = "Software\\Policies\\Vendor\\Product\\Group" + std::to_string(i % 50);
+        instruction.value = "Value" + std::to_string(i);
+
+        switch (i % 4) {
+        case 0:
+            instruction.type = pol::PolicyRegType::REG_DWORD_LITTLE_ENDIAN;
+            instruction.data = uint32_t(i);
+            break;
+        case 1:
+            instruction.type = pol::PolicyRegType::REG_SZ;
+            instruction.data = std::string("https://example.org/path/") + std::to_string(i);
+            break;
+        case 2:
+            instruction.type = pol::PolicyRegType::REG_MULTI_SZ;
+            instruction.data = std::vector<std::string>{ "first", "second", std::to_string(i) };
+            break;
+        default:
+            instruction.type = pol::PolicyRegType::REG_BINARY;
+            instruction.data = std::vector<uint8_t>(32, uint8_t(i));
+            break;
+        }
+        file.instructions.push_back(std::move(instruction));
+    }
+
+    return file;
+}
+
+template <typename Callable>
+static double measure(Callable callable)
+{
+    auto begin = std::chrono::steady_clock::now();
+    callable();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+static void benchParseMany()
+{
+    auto parser = pol::createPregParser();
+    std::vector<std::vector<uint8_t>> buffers(2000, parser->serialize(makeFile(500)));
+    size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    double single = 0;
+
+    std::cout << "parseMany: " << buffers.size() << " files x 500 instructions" << std::endl;
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        pol::ParseManyOptions options;
+        options.threads = threads;
+
+        double time = measure([&]() { pol::parseMany(buffers, options); });
+        if (threads == 1) {
+            single = time;
+        }
+        std::cout << "  threads: " << threads << ", time: " << time
+                  << " ms, speedup: " << single / time << std::endl;
+    }
+}
+
+static void benchBatchRead()
+{
+    auto parser = pol::createPregParser();
+    auto buffer = parser->serialize(makeFile(100));
+    auto directory = std::filesystem::temp_directory_path();
+    std::vector<std::string> paths;
+
+    for (size_t i = 0; i < 2000; ++i) {
+        paths.push_back((directory / ("parsepol-bench-" + std::to_string(i) + ".pol")).string());
+        std::ofstream file(paths.back(), std::ios::out | std::ios::binary);
+        file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+    }
+
+    std::cout << "parseMany from files: " << paths.size() << " files x 100 instructions"
+              << " (warm cache, io_uring: " << (pol::isIoUringAvailable() ? "yes" : "no") << ")"
+              << std::endl;
+    for (bool batchRead : { false, true }) {
+        pol::ParseManyOptions options;
+        options.batchRead = batchRead;
+
+        double time = measure([&]() { pol::parseMany(paths, options); });
+        std::cout << "  batch read: " << (batchRead ? "yes" : "no") << ", time: " << time << " ms"
+                  << std::endl;
+    }
+
+    for (const auto &path : paths) {
+        std::remove(path.c_str());
+    }
+}
+
+static void benchStreamParse()
+{
+    auto parser = pol::createPregParser();
+    auto buffer = parser->serialize(makeFile(100000));
+    auto path = (std::filesystem::temp_directory_path() / "parsepol-bench.pol").string();
+    std::ofstream(path, std::ios::out | std::ios::binary)
+            .write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+
+    std::cout << "parse: 100000 instructions, " << buffer.size() << " bytes" << std::endl;
+
+    double time = measure([&]() {
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        parser->parse(file);
+    });
+    std::cout << "  std::ifstream: " << time << " ms" << std::endl;
+
+    std::stringstream stream(std::string(buffer.begin(), buffer.end()));
+    time = measure([&]() { parser->parse(stream); });
+    std::cout << "  std::stringstream: " << time << " ms" << std::endl;
+
+    time = measure([&]() { parser->parse(buffer.data(), buffer.size()); });
+    std::cout << "  memory buffer: " << time << " ms" << std::endl;
+
+    time = measure([&]() {
+        pol::BufferSource source(buffer.data(), buffer.size());
+        parser->parseFrom(source);
+    });
+    std::cout << "  BufferSource: " << time << " ms" << std::endl;
+
+    time = measure([&]() {
+        pol::MmapSource source(path);
+        parser->parseFrom(source);
+    });
+    std::cout << "  MmapSource: " << time << " ms" << std::endl;
+
+    auto file = parser->parse(buffer.data(), buffer.size());
+    std::cout << "write: 100000 instructions" << std::endl;
+
+    time = measure([&]() {
+        std::stringstream output;
+        parser->write(output, file);
+    });
+    std::cout << "  std::stringstream: " << time << " ms" << std::endl;
+
+    time = measure([&]() { parser->serialize(file); });
+    std::cout << "  serialize: " << time << " ms" << std::endl;
+
+    std::remove(path.c_str());
+}
+
+static void benchEditAndSave()
+{
+    auto parser = pol::createPregParser();
+    auto owner = std::make_shared<std::vector<uint8_t>>(parser->serialize(makeFile(100000)));
+
+    std::cout << "edit 10 of 100000 instructions and save" << std::endl;
+    for (bool raw : { false, true }) {
+        auto file = raw ? parser->parse(owner, owner->data(), owner->size())
+                        : parser->parse(owner->data(), owner->size());
+        for (size_t i = 0; i < 10; ++i) {
+            file.instructions[i * 10000].value = "Edited" + std::to_string(i);
+            file.instructions[i * 10000].raw = {};
+        }
+
+        double time = measure([&]() { parser->serialize(file); });
+        std::cout << "  raw passthrough: " << (raw ? "yes" : "no") << ", save: " << time << " ms"
+                  << std::endl;
+    }
+
+    auto edits = parser->parse(owner->data(), owner->size());
+    double time = measure([&]() {
+        pol::PolicyDocument document(owner, owner->data(), owner->size());
+        for (size_t i = 0; i < 10; ++i) {
+            auto instruction = edits.instructions[i * 10000];
+            instruction.data = std::string("Edited") + std::to_string(i);
+            instruction.type = pol::PolicyRegType::REG_SZ;
+            document.set(instruction);
+        }
+        document.save();
+    });
+    std::cout << "  document open, edit and save: " << time << " ms" << std::endl;
+}
+
+static void benchCanonicalOrder()
+{
+    auto file = makeFile(1000000);
+    std::reverse(file.instructions.begin(), file.instructions.end());
+
+    std::cout << "canonical order of 1000000 instructions" << std::endl;
+    double time = measure([&]() { pol::canonicalOrder(file.instructions); });
+    std::cout << "  multikey sort: " << time << " ms" << std::endl;
+
+    time = measure([&]() {
+        std::vector<std::pair<std::string, size_t>> keys;
+        keys.reserve(file.instructions.size());
+        for (size_t i = 0; i < file.instructions.size(); ++i) {
+            auto key = file.instructions[i].key + '\0' + file.instructions[i].value;
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+            keys.emplace_back(std::move(key), i);
+        }
+        std::sort(keys.begin(), keys.end());
+    });
+    std::cout << "  std::sort of lowercase keys: " << time << " ms" << std::endl;
+}
+
+static void benchColumnScan()
+{
+    auto file = makeFile(1000000);
+    auto columns = pol::PolicyColumns::fromFile(file);
+    const std::string keypath = "Software\\Policies\\Vendor\\Product\\Group8";
+    size_t count = 0;
+
+    std::cout << "count DWORD instructions of keypath with even data in 1000000 instructions"
+              << std::endl;
+    double time = measure([&]() {
+        count = 0;
+        for (const auto &instruction : file.instructions) {
+            auto number = std::get_if<uint32_t>(&instruction.data);
+            count += instruction.key == keypath && number && *number % 2 == 0;
+        }
+    });
+    std::cout << "  PolicyTree: " << time << " ms, found " << count << std::endl;
+
+    time = measure([&]() {
+        count = 0;
+        auto id = columns.findString(keypath);
+        const auto &keypaths = columns.keypaths();
+        const auto &types = columns.types();
+        for (size_t i = 0; id && i < columns.size(); ++i) {
+            count += keypaths[i] == *id && types[i] == pol::PolicyRegType::REG_DWORD_LITTLE_ENDIAN
+                    && columns.integer(i) % 2 == 0;
+        }
+    });
+    std::cout << "  PolicyColumns: " << time << " ms, found " << count << std::endl;
+}
+
+static void benchMultiString()
+{
+    auto parser = pol::createPregParser();
+    pol::PolicyFile file;
+
+    for (size_t i = 0; i < 100; ++i) {
+        std::vector<std::string> urls;
+        for (size_t j = 0; j < 2000; ++j) {
+            urls.push_back("https://" + std::to_string(j) + ".example.org/");
+        }
+        file.instructions.push_back({ pol::PolicyRegType::REG_MULTI_SZ, std::move(urls),
+                                      "Software\\Policies\\Browser", "Allow" + std::to_string(i) });
+    }
+    auto buffer = parser->serialize(file);
+
+    std::cout << "parse 100 REG_MULTI_SZ lists of 2000 strings" << std::endl;
+    double time = measure([&]() { parser->parse(buffer.data(), buffer.size()); });
+    std::cout << "  memory: " << time << " ms" << std::endl;
+}
+
+int main()
+{
+    benchStreamParse();
+    benchEditAndSave();
+    benchParseMany();
+    benchBatchRead();
+    benchCanonicalOrder();
+    benchColumnScan();
+    benchMultiString();
+    return 0;
+}
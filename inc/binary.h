@@ -24,9 +24,11 @@
 #include <cinttypes>
 #include <iostream>
 #include <optional>
+#include <string_view>
 #include <vector>
 
 #include <encoding.h>
+#include <sink.h>
 
 namespace pol {
 
@@ -73,11 +75,91 @@ size_t writeStringsFromBuffer(std::ostream &buffer, const std::vector<std::strin
  */
 std::vector<uint8_t> readVectorFromBuffer(std::istream &buffer, size_t size);
 
+/*!
+ * \brief Skip `size` bytes of istream (binary) without storing them
+ */
+void skipBuffer(std::istream &buffer, size_t size);
+
 /*!
  * \brief Put vector of raw data to istream (binary)
  */
 void writeVectorToBuffer(std::ostream &buffer, const std::vector<uint8_t> &data);
 
+/*!
+ * \brief Get string from memory (binary), `size` bytes of UTF-16LE ended with '\0'
+ * \warning `conv` must be initialized by `iconv_open("UTF-8", "UTF-16LE")`
+ */
+std::string readStringFromMemory(const uint8_t *data, size_t size, iconv_t conv);
+/*!
+ * \brief Get strings from memory (binary), same layout as in `readStringsFromBuffer`
+ * \warning `conv` must be initialized by `iconv_open("UTF-8", "UTF-16LE")`
+ */
+std::vector<std::string> readStringsFromMemory(const uint8_t *data, size_t size, iconv_t conv);
+
+/*!
+ * \brief Put null-terminated UTF-16LE string to sink (binary). Converted chunks go straight to
+ * the sink, no intermediate string is built.
+ * \return Size of writed string
+ * \warning `conv` must be initialized by `iconv_open("UTF-16LE", "UTF-8")`
+ */
+template <typename Sink>
+size_t writeStringToSink(Sink &sink, std::string_view data, iconv_t conv)
+{
+    size_t written = 0;
+    const char16_t terminator = 0;
+
+    convertChunked<char16_t, char>(data.data(), data.data() + data.size(), conv,
+                                   [&sink, &written](const char16_t *begin, const char16_t *end) {
+                                       auto size = (end - begin) * sizeof(char16_t);
+                                       sink.write(reinterpret_cast<const uint8_t *>(begin), size);
+                                       written += size;
+                                   });
+    writeSymbol(sink, terminator);
+
+    return written + sizeof(char16_t);
+}
+/*!
+ * \brief Put strings to sink (binary), same layout as in `writeStringsFromBuffer`
+ * \warning `conv` must be initialized by `iconv_open("UTF-16LE", "UTF-8")`
+ */
+template <typename Sink>
+size_t writeStringsToSink(Sink &sink, const std::vector<std::string> &data, iconv_t conv)
+{
+    size_t size = 0;
+
+    for (const auto &str : data) {
+        size += writeStringToSink(sink, str, conv);
+    }
+
+    return size;
+}
+/*!
+ * \brief Put vector of raw data to sink (binary)
+ */
+template <typename Sink>
+inline void writeVectorToSink(Sink &sink, const std::vector<uint8_t> &data)
+{
+    sink.write(data.data(), data.size());
+}
+
+/*!
+ * \brief Get integral number from memory (binary), `data` must contain `sizeof(T)` bytes
+ */
+template <typename T, bool LE = true,
+          typename = std::enable_if_t<std::is_integral_v<T>
+                                      && sizeof(T) <= sizeof(unsigned long long)>>
+inline T readIntegralFromMemory(const uint8_t *data)
+{
+    T num;
+
+    memcpy(&num, data, sizeof(T));
+    if constexpr (LE) {
+        return leToNative<T>(num);
+    } else {
+        return beToNative<T>(num);
+    }
+}
+
 /*!
  * \brief Get integral number from istream (binary)
  */
@@ -0,0 +1,46 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_CANONICAL
+#define PREGPARSER_CANONICAL
+
+#include <vector>
+
+#include <parser.h>
+
+namespace pol {
+
+/*!
+ * \brief Positions of instructions in canonical order: (keypath, value) pairs are compared
+ * case-insensitively (like registry does), the last instruction of equal pairs is kept, the rest
+ * are dropped. Instructions are sorted by keypath, then by value, with multikey quicksort over
+ * lowercase names, so long shared keypath prefixes are compared once per level instead of once
+ * per comparison.
+ * Canonical order makes output reproducible, it does not keep order-dependent meaning of special
+ * values (see `RegistryModel`).
+ */
+std::vector<size_t> canonicalOrder(const PolicyTree &instructions);
+/*!
+ * \brief Deduplicate and sort instructions of `file`, see `canonicalOrder`
+ */
+void canonicalize(PolicyFile &file);
+
+} // namespace pol
+
+#endif // PREGPARSER_CANONICAL
@@ -0,0 +1,136 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_CASEFOLD
+#define PREGPARSER_CASEFOLD
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include <hash.h>
+
+namespace pol {
+
+/*!
+ * \brief ASCII uppercase letter made lowercase. Registry names are compared ignoring ASCII case
+ * only, every part of library folding names (registry model, diff, canonical order, document,
+ * index, hash tree) uses helpers of this header.
+ */
+inline char foldCase(char sym)
+{
+    return sym >= 'A' && sym <= 'Z' ? static_cast<char>(sym - 'A' + 'a') : sym;
+}
+
+/*!
+ * \brief Lowercase copy of name
+ */
+inline std::string foldCase(std::string_view name)
+{
+    std::string result(name);
+
+    for (auto &sym : result) {
+        sym = foldCase(sym);
+    }
+
+    return result;
+}
+
+/*!
+ * \brief ASCII uppercase letters of 8 bytes made lowercase at once, other bytes are unchanged.
+ * Also folds raw UTF-16LE names, high byte of ASCII unit is zero.
+ */
+inline uint64_t foldWord(uint64_t word)
+{
+    const uint64_t ones = 0x0101010101010101ULL;
+    uint64_t heptets = word & (0x7F * ones);
+    uint64_t atLeastA = heptets + (0x80 - 'A') * ones;
+    uint64_t aboveZ = heptets + (0x7F - 'Z') * ones;
+
+    return word | ((atLeastA & ~aboveZ & ~word & (0x80 * ones)) >> 2);
+}
+
+/*!
+ * \brief Compare names by bytes of their lowercase forms, like `canonicalOrder` sorts them
+ */
+inline int compareFolded(std::string_view lhs, std::string_view rhs)
+{
+    auto size = std::min(lhs.size(), rhs.size());
+
+    for (size_t i = 0; i < size; ++i) {
+        auto left = static_cast<unsigned char>(foldCase(lhs[i]));
+        auto right = static_cast<unsigned char>(foldCase(rhs[i]));
+        if (left != right) {
+            return left < right ? -1 : 1;
+        }
+    }
+
+    return lhs.size() == rhs.size() ? 0 : (lhs.size() < rhs.size() ? -1 : 1);
+}
+
+/*!
+ * \brief Names are equal ignoring ASCII case
+ */
+inline bool equalFolded(std::string_view lhs, std::string_view rhs)
+{
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+    // Names are usually spelled the same way.
+    if (memcmp(lhs.data(), rhs.data(), lhs.size()) == 0) {
+        return true;
+    }
+
+    for (size_t offset = 0; offset < lhs.size(); offset += sizeof(uint64_t)) {
+        auto size = std::min(lhs.size() - offset, sizeof(uint64_t));
+        uint64_t left = 0;
+        uint64_t right = 0;
+        memcpy(&left, lhs.data() + offset, size);
+        memcpy(&right, rhs.data() + offset, size);
+        if (foldWord(left) != foldWord(right)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*!
+ * \brief Hash of name ignoring ASCII case. Single multiply per word, the whole name is mixed once
+ * at the end; `seed` chains names of entry. Same on every host, so it may be stored.
+ */
+inline uint64_t hashFolded(std::string_view name, uint64_t seed = 0)
+{
+    uint64_t hash = seed ^ (name.size() * 0x9E3779B97F4A7C15ULL);
+
+    for (size_t offset = 0; offset < name.size(); offset += sizeof(uint64_t)) {
+        auto size = std::min(name.size() - offset, sizeof(uint64_t));
+        uint64_t word = 0;
+        memcpy(&word, name.data() + offset, size);
+        hash = (hash ^ leToNative(foldWord(word))) * 0x100000001B3ULL;
+        hash ^= hash >> 32;
+    }
+
+    return hashMix(hash);
+}
+
+} // namespace pol
+
+#endif // PREGPARSER_CASEFOLD
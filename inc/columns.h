@@ -0,0 +1,94 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_COLUMNS
+#define PREGPARSER_COLUMNS
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <layout.h>
+#include <parser.h>
+
+namespace pol {
+
+/*!
+ * \brief Struct-of-arrays layout of PolicyFile for scans over many instructions. Instruction
+ * `i` is the `i`-th element of every column. Keypaths and values are ids of strings interned in
+ * string pool, so they are compared as integers. Data is a range of blob pool, encoded by
+ * `encodeData`.
+ */
+class PolicyColumns final
+{
+public:
+    static PolicyColumns fromFile(const PolicyFile &file);
+    PolicyFile toFile() const;
+
+    void add(const PolicyInstruction &instruction);
+    void reserve(size_t count);
+    size_t size() const;
+
+    const std::vector<uint32_t> &keypaths() const;
+    const std::vector<uint32_t> &values() const;
+    const std::vector<PolicyRegType> &types() const;
+    const std::vector<uint64_t> &dataOffsets() const;
+    const std::vector<uint32_t> &dataSizes() const;
+
+    size_t stringCount() const;
+    std::string_view string(uint32_t id) const;
+    /*!
+     * \brief Id of interned string, empty if there is no such keypath or value
+     */
+    std::optional<uint32_t> findString(std::string_view string) const;
+
+    /*!
+     * \brief Data bytes of instruction in blob pool
+     */
+    std::string_view blob(size_t index) const;
+    /*!
+     * \brief DWORD or QWORD data, 0 for other alternatives
+     */
+    uint64_t integer(size_t index) const;
+    PolicyData data(size_t index) const;
+    PolicyInstruction instruction(size_t index) const;
+
+private:
+    uint32_t intern(std::string_view string);
+
+    std::vector<uint32_t> m_keypaths{};
+    std::vector<uint32_t> m_values{};
+    std::vector<PolicyRegType> m_types{};
+    std::vector<uint64_t> m_dataOffsets{};
+    std::vector<uint32_t> m_dataSizes{};
+    std::vector<PolicyDataAlternative> m_alternatives{};
+
+    /* Interned strings, string `id` is [m_stringOffsets[id], m_stringOffsets[id + 1]) */
+    std::string m_strings{};
+    std::vector<uint64_t> m_stringOffsets{ 0 };
+    /* Ids of interned strings by `hashString` */
+    std::unordered_multimap<uint64_t, uint32_t> m_stringIds{};
+    std::string m_blobs{};
+};
+
+} // namespace pol
+
+#endif // PREGPARSER_COLUMNS
@@ -23,8 +23,13 @@
 
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <string_view>
+#include <vector>
 
 #include <encoding.h>
+#include <sink.h>
+#include <source.h>
 
 namespace pol {
 
@@ -46,26 +51,101 @@ inline void check_stream(std::ostream &target)
                                  + ", Failed to write buffer, error was encountered.");
     }
 }
-inline void check_sym(std::istream &target, char16_t sym)
+template <typename Source>
+inline void check_sym(Source &target, char16_t sym)
 {
-    char16_t buff;
-    target.read(reinterpret_cast<char *>(&buff), 2);
-    buff = leToNative(buff);
-
-    check_stream(target);
-
-    if (buff != sym) {
+    if (readSymbol(target) != sym) {
         throw std::runtime_error(
                 "LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
                 + ", Failed to read/write buffer, invalid symbol was encountered.");
     }
 }
-inline void write_sym(std::ostream &target, char16_t sym)
+template <typename Sink>
+inline void write_sym(Sink &target, char16_t sym)
+{
+    writeSymbol(target, sym);
+}
+
+/*!
+ * \brief Valid POL Registery file header. Binary equal valid header.
+ * leToNative is used because the entry 0x0167655250 is
+ * equivalent to the header in case uint64_t stores a number in LittleEndian.
+ * BigEndian - 0x00 0x00 0x00 0x01 0x67 0x65 0x52 0x50 (bytes must be swaped)
+ */
+inline const uint64_t valid_header = leToNative<uint64_t>(0x0167655250);
+
+/*!
+ * \brief Size of UTF-8 string converted to null-terminated UTF-16LE string
+ */
+inline size_t getStringDataSize(std::string_view data)
+{
+    return (utf16Length(data.data(), data.data() + data.size()) + 1) * sizeof(char16_t);
+}
+
+/*!
+ * \brief Keypath is `\` separated list of non-empty keys of printable ASCII, like parser expects.
+ * Both `PRegWriter` and `PRegParser` validate by it, so they accept the same instructions.
+ */
+inline void validateKeypath(std::string_view keypath)
+{
+    bool emptyKey = true;
+
+    for (char sym : keypath) {
+        if (sym == '\\' && !emptyKey) {
+            emptyKey = true;
+        } else if (sym >= 0x20 && sym <= 0x7E && sym != '\\') {
+            emptyKey = false;
+        } else {
+            throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                     + ", Invalid keypath " + std::string(keypath) + ".");
+        }
+    }
+
+    if (emptyKey) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Invalid keypath " + std::string(keypath) + ".");
+    }
+}
+
+/*!
+ * \brief Value is up to 259 symbols of printable ASCII, like parser expects
+ */
+inline void validateValue(std::string_view value)
 {
-    sym = nativeToLe(sym);
-    target.write(reinterpret_cast<char *>(&sym), 2);
+    bool valid = value.size() <= 259;
+
+    for (size_t i = 0; valid && i < value.size(); ++i) {
+        valid = value[i] >= 0x20 && value[i] <= 0x7E;
+    }
 
-    check_stream(target);
+    if (!valid) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Invalid value " + std::string(value) + ".");
+    }
+}
+
+/*!
+ * \brief Destroy subtrees of tree node by worklist: `children` maps names to
+ * `std::unique_ptr<Node>`, every Node keeps its own in `member`. Recursive destruction of deep
+ * trees (one level per keypath key) would overflow the stack.
+ */
+template <typename Node, typename Children>
+inline void releaseSubtrees(Children &children, Children Node::*member)
+{
+    std::vector<std::unique_ptr<Node>> pending;
+    auto drain = [&pending](Children &nodes) {
+        for (auto &node : nodes) {
+            pending.push_back(std::move(node.second));
+        }
+        nodes.clear();
+    };
+
+    drain(children);
+    while (!pending.empty()) {
+        auto node = std::move(pending.back());
+        pending.pop_back();
+        drain((*node).*member);
+    }
 }
 } // namespace pol
 
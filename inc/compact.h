@@ -0,0 +1,111 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_COMPACT
+#define PREGPARSER_COMPACT
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <layout.h>
+#include <parser.h>
+
+namespace pol {
+
+/*!
+ * \brief 16 byte tagged payload: data encoded by `encodeData`, inline if it is short (integers
+ * always are), otherwise as offset and size in pool of PolicyCompactFile.
+ */
+typedef struct PolicyCompactData
+{
+    /* Inline bytes, or offset (uint64) and size (uint32) in pool */
+    uint8_t payload[14]{};
+    /* Size of inline bytes */
+    uint8_t size{};
+    /* Storage (low 2 bits) and alternative of PolicyData (the rest) */
+    uint8_t tag{};
+} PolicyCompactData;
+
+typedef struct PolicyCompactInstruction
+{
+    PolicyCompactData key{};
+    PolicyCompactData value{};
+    PolicyCompactData data{};
+    uint8_t type{};
+} PolicyCompactInstruction;
+
+/*!
+ * \brief Memory-compact alternative of PolicyFile: instructions are fixed size records without
+ * own heap allocations, long payloads share one pool, repeated keypaths are stored once.
+ * Strings and blobs are read as views into it, `data` and `instruction` decode them back.
+ */
+class PolicyCompactFile final
+{
+public:
+    static PolicyCompactFile fromFile(const PolicyFile &file);
+    /*!
+     * \brief Parse POL Registry file in memory straight into compact form, decoding instructions
+     * one at a time. Limits of parser are checked for whole file before anything is decoded.
+     */
+    static PolicyCompactFile parse(PRegParser &parser, const uint8_t *data, size_t size);
+    PolicyFile toFile() const;
+
+    void add(const PolicyInstruction &instruction);
+    void reserve(size_t count);
+
+    size_t size() const;
+    std::string_view key(size_t index) const;
+    std::string_view value(size_t index) const;
+    PolicyRegType type(size_t index) const;
+    /*!
+     * \brief Data bytes of instruction, see `encodeData`
+     */
+    std::string_view bytes(size_t index) const;
+    /*!
+     * \brief Integer data, 0 for other alternatives
+     */
+    uint64_t integer(size_t index) const;
+    PolicyData data(size_t index) const;
+    PolicyInstruction instruction(size_t index) const;
+
+    /*!
+     * \brief Approximate heap memory used by instructions and pools
+     */
+    size_t memoryUsage() const;
+
+private:
+    PolicyCompactData store(std::string_view bytes, PolicyDataAlternative alternative);
+    /*!
+     * \brief Store bytes appended to pool since `offset`, short bytes are moved inline
+     */
+    PolicyCompactData store(size_t offset, PolicyDataAlternative alternative);
+    PolicyCompactData storeKeypath(std::string_view keypath);
+    std::string_view getBytes(const PolicyCompactData &data) const;
+
+    std::vector<PolicyCompactInstruction> m_instructions{};
+    std::string m_pool{};
+    /* Keypaths stored in pool by `hashString` */
+    std::unordered_multimap<uint64_t, PolicyCompactData> m_keypaths{};
+};
+
+} // namespace pol
+
+#endif // PREGPARSER_COMPACT
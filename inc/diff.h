@@ -0,0 +1,60 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_DIFF
+#define PREGPARSER_DIFF
+
+#include <vector>
+
+#include <parser.h>
+
+namespace pol {
+
+typedef struct PolicyChange
+{
+    PolicyInstruction before{};
+    PolicyInstruction after{};
+} PolicyChange;
+
+/*!
+ * \brief Difference between two PolicyFile, entries are identified by (keypath, value) ignoring
+ * ASCII case.
+ */
+typedef struct PolicyDiff
+{
+    inline bool empty() const { return added.empty() && removed.empty() && changed.empty(); }
+
+    PolicyTree added{};
+    PolicyTree removed{};
+    std::vector<PolicyChange> changed{};
+} PolicyDiff;
+
+/*!
+ * \brief Compute difference from `a` to `b` in linear time.
+ * Entries are matched by (keypath, value) ignoring ASCII case, like registry names are, when the
+ * pair repeats the last instruction wins (like it does when policy is applied). Entry is
+ * `changed` when its type or data differs. If both trees are sorted like `canonicalOrder` sorts
+ * them, they are merged without building hash index.
+ * \return `added` and `changed` in order of `b`, `removed` in order of `a`.
+ */
+PolicyDiff diff(const PolicyFile &a, const PolicyFile &b);
+
+} // namespace pol
+
+#endif // PREGPARSER_DIFF
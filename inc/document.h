@@ -0,0 +1,162 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_DOCUMENT
+#define PREGPARSER_DOCUMENT
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <parser.h>
+
+namespace pol {
+
+/*!
+ * \brief Contiguous span of encoded file
+ */
+typedef struct PolicySpan
+{
+    const uint8_t *data{};
+    size_t size{};
+} PolicySpan;
+
+/*!
+ * \brief Editable POL Registry file over its encoded form. Original buffer is never modified
+ * and instructions are not decoded on open: edits are encoded into buffers of their own,
+ * removed instructions become tombstones until they are the most of instructions. Saving gathers unmodified runs of the original buffer and
+ * edited instructions, see `spans`.
+ * Instructions are keyed by (keypath, value) ignoring ASCII case, like registry names are. If
+ * file repeats the key, the last instruction is found and edits replace all of them.
+ */
+class PolicyDocument final
+{
+public:
+    /*!
+     * \brief Empty document
+     */
+    PolicyDocument();
+    /*!
+     * \brief Document over owned buffer
+     */
+    explicit PolicyDocument(std::vector<uint8_t> buffer);
+    /*!
+     * \brief Document over buffer kept alive by `owner`
+     */
+    PolicyDocument(std::shared_ptr<const void> owner, const uint8_t *data, size_t size);
+    /*!
+     * \brief Document over memory mapped file
+     */
+    static PolicyDocument map(const std::string &path);
+
+    PolicyDocument(PolicyDocument &&);
+    PolicyDocument &operator=(PolicyDocument &&);
+    ~PolicyDocument();
+
+    /*!
+     * \brief Count of instructions with distinct keys
+     */
+    size_t size() const;
+    bool contains(std::string_view keypath, std::string_view value) const;
+    /*!
+     * \brief Decode instruction by key, empty if it is absent
+     */
+    std::optional<PolicyInstruction> find(std::string_view keypath, std::string_view value) const;
+    /*!
+     * \brief Replace instruction with the same key in place, or append it
+     */
+    void set(const PolicyInstruction &instruction);
+    /*!
+     * \brief Append instruction if its key is absent
+     * \return false if key is present, document is not changed then
+     */
+    bool insert(const PolicyInstruction &instruction);
+    /*!
+     * \brief Remove every instruction with key
+     * \return false if key is absent
+     */
+    bool erase(std::string_view keypath, std::string_view value);
+
+    /*!
+     * \brief Spans forming the current file, in order (header included). Adjacent unmodified
+     * instructions are merged into one span. Spans are valid until next edit.
+     */
+    std::vector<PolicySpan> spans() const;
+    /*!
+     * \brief Put current file into byte sink, instantiated for the same sinks as
+     * `PRegParser::writeTo`
+     */
+    template <typename Sink>
+    void save(Sink &sink) const;
+    std::vector<uint8_t> save() const;
+
+private:
+    PolicyDocument(const PolicyDocument &) = delete;
+    void operator=(const PolicyDocument &) = delete;
+
+    typedef struct Slot
+    {
+        /* Original buffer or buffer of edited instruction */
+        const uint8_t *base{};
+        PolicyInstructionBounds bounds{};
+        /* Previous instruction with the same key */
+        size_t previous{};
+        bool erased{};
+        /* Encoded edited instruction, `base` refers to it. Released when slot is erased. */
+        std::vector<uint8_t> edit{};
+    } Slot;
+
+    struct Editor;
+
+    /*!
+     * \brief Hash and equality of index keys ignoring ASCII case
+     */
+    struct KeyHash
+    {
+        size_t operator()(std::string_view key) const;
+    };
+    struct KeyEqual
+    {
+        bool operator()(std::string_view lhs, std::string_view rhs) const;
+    };
+
+    void open();
+    void eraseChain(size_t slot);
+    /*!
+     * \brief Drop tombstones if they are the most of slots
+     */
+    void compact();
+
+    std::shared_ptr<const void> m_owner{};
+    const uint8_t *m_data{};
+    size_t m_size{};
+    std::vector<Slot> m_slots{};
+    /* Count of tombstones in `m_slots` */
+    size_t m_erased{};
+    /* Keys refer to encoded names in original buffer or edits */
+    std::unordered_map<std::string_view, size_t, KeyHash, KeyEqual> m_index{};
+    std::unique_ptr<Editor> m_editor{};
+};
+
+} // namespace pol
+
+#endif // PREGPARSER_DOCUMENT
@@ -23,9 +23,11 @@
 
 #include <array>
 #include <cerrno>
+#include <iterator>
 #include <limits>
 #include <memory>
 #include <stdexcept>
+#include <string>
 #include <string.h>
 #include <type_traits>
 
@@ -140,6 +142,36 @@ inline constexpr T nativeToLe(T num)
 template <class T>
 using string_const_iterator = typename std::basic_string<T>::const_iterator;
 
+/*!
+ * \brief Convert string from one encoding to another using iconv, passing converted data to
+ * `consumer(const target_char *begin, const target_char *end)` in chunks of fixed size.
+ * No heap memory is used for conversion.
+ */
+template <typename target_char, typename source_char, typename Consumer>
+inline void convertChunked(const source_char *begin, const source_char *end, iconv_t conv,
+                           Consumer &&consumer)
+{
+    std::array<target_char, 512> temp;
+
+    char *inbuf = reinterpret_cast<char *>(const_cast<source_char *>(begin));
+    size_t inbytesLeft = std::distance(begin, end) * sizeof(source_char);
+
+    while (inbytesLeft > 0) {
+        target_char *outbuf = temp.data();
+        size_t outbytesLeft = temp.size() * sizeof(target_char);
+
+        auto ret = iconv(conv, &inbuf, &inbytesLeft, reinterpret_cast<char **>(&outbuf),
+                         &outbytesLeft);
+        if (ret == ICONV_ERROR_CODE && errno != E2BIG) {
+            throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                     + ", Encountered corrupted unicode string.");
+        }
+
+        consumer(static_cast<const target_char *>(temp.data()),
+                 static_cast<const target_char *>(outbuf));
+    }
+}
+
 /*!
  * \brief Convert string from one encoding to another using iconv
  */
@@ -149,26 +181,69 @@ inline std::basic_string<target_char> convert(string_const_iterator<source_char>
 {
     std::basic_string<target_char> result = {};
 
-    char *inbuf = reinterpret_cast<char *>(const_cast<source_char *>(&*begin));
-    size_t inbytesLeft = std::distance(begin, end) * sizeof(source_char);
+    if (begin == end) {
+        return result;
+    }
 
-    auto temp = std::make_unique<std::array<target_char, 512>>();
-    target_char *outbuf = temp->data();
-    size_t outbytesLeft = temp->size();
+    convertChunked<target_char, source_char>(
+            &*begin, &*begin + std::distance(begin, end), conv,
+            [&result](const target_char *chunkBegin, const target_char *chunkEnd) {
+                result.append(chunkBegin, chunkEnd);
+            });
 
-    while (inbytesLeft > 0) {
-        auto ret = iconv(conv, &inbuf, &inbytesLeft, reinterpret_cast<char**>(&outbuf), &outbytesLeft);
-        if (ret == ICONV_ERROR_CODE && errno != E2BIG) {
+    return result;
+}
+
+/*!
+ * \brief Number of UTF-16 code units required to store UTF-8 string (without terminator).
+ * Computed without conversion, code points from 4-byte sequences take surrogate pair.
+ * Throws an std::runtime_error on invalid UTF-8 (the same strings iconv rejects: truncated and
+ * overlong sequences, surrogates, code points above U+10FFFF), so string is known to convert
+ * before anything of it is written.
+ */
+inline size_t utf16Length(const char *begin, const char *end)
+{
+    size_t length = 0;
+
+    while (begin != end) {
+        auto sym = static_cast<uint8_t>(*begin);
+        if (sym < 0x80) {
+            ++length;
+            ++begin;
+            continue;
+        }
+
+        size_t extra = 0;
+        uint32_t point = 0;
+        if (sym >= 0xC2 && sym <= 0xDF) {
+            extra = 1;
+            point = sym & 0x1F;
+        } else if (sym >= 0xE0 && sym <= 0xEF) {
+            extra = 2;
+            point = sym & 0x0F;
+        } else if (sym >= 0xF0 && sym <= 0xF4) {
+            extra = 3;
+            point = sym & 0x07;
+        }
+
+        bool valid = extra != 0 && static_cast<size_t>(end - begin) > extra;
+        for (size_t i = 1; valid && i <= extra; ++i) {
+            auto next = static_cast<uint8_t>(begin[i]);
+            valid = (next & 0xC0) == 0x80;
+            point = (point << 6) | (next & 0x3F);
+        }
+        valid = valid && (extra != 2 || (point >= 0x800 && (point < 0xD800 || point > 0xDFFF)))
+                && (extra != 3 || (point >= 0x10000 && point <= 0x10FFFF));
+        if (!valid) {
             throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
                                      + ", Encountered corrupted unicode string.");
         }
 
-        result.append(temp->data(), outbuf);
-        outbuf = temp->data();
-        outbytesLeft = temp->size();
+        length += extra == 3 ? 2 : 1;
+        begin += extra + 1;
     }
 
-    return result;
+    return length;
 }
 
 /*!
@@ -0,0 +1,139 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_HASH
+#define PREGPARSER_HASH
+
+#include <cinttypes>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+#include <encoding.h>
+#include <parser.h>
+
+namespace pol {
+
+/*!
+ * \brief Finalization mix of MurmurHash3 (64 bit)
+ */
+inline uint64_t hashMix(uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDULL;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+/*!
+ * \brief Combine hash `value` into `seed`. Order-sensitive.
+ */
+inline uint64_t hashCombine(uint64_t seed, uint64_t value)
+{
+    return hashMix(seed ^ (value + 0x9E3779B97F4A7C15ULL + (seed << 6) + (seed >> 2)));
+}
+
+/*!
+ * \brief Hash raw bytes. Result does not depend on native endianness, so it may be persisted.
+ */
+inline uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 0)
+{
+    auto cursor = reinterpret_cast<const uint8_t *>(data);
+    uint64_t hash = seed ^ (size * 0x9E3779B97F4A7C15ULL);
+
+    while (size >= 8) {
+        uint64_t word;
+        memcpy(&word, cursor, 8);
+        hash = hashMix(hash ^ leToNative(word)) * 0x100000001B3ULL;
+        cursor += 8;
+        size -= 8;
+    }
+
+    uint64_t tail = 0;
+    for (size_t i = 0; i < size; ++i) {
+        tail |= static_cast<uint64_t>(cursor[i]) << (i * 8);
+    }
+
+    return hashMix(hash ^ tail);
+}
+
+inline uint64_t hashString(std::string_view data, uint64_t seed = 0)
+{
+    return hashBytes(data.data(), data.size(), seed);
+}
+
+/*!
+ * \brief Hash of instruction identity (keypath, value)
+ */
+inline uint64_t hashEntry(std::string_view keypath, std::string_view value, uint64_t seed = 0)
+{
+    return hashString(value, hashString(keypath, seed));
+}
+
+/*!
+ * \brief Hash of instruction data, alternatives of PolicyData with equal bytes differ
+ */
+inline uint64_t hashData(const PolicyData &data, uint64_t seed = 0)
+{
+    seed = hashCombine(seed, data.index());
+
+    if (auto string = std::get_if<std::string>(&data)) {
+        return hashString(*string, seed);
+    }
+    if (auto binary = std::get_if<std::vector<uint8_t>>(&data)) {
+        return hashBytes(binary->data(), binary->size(), seed);
+    }
+    if (auto number = std::get_if<uint32_t>(&data)) {
+        return hashCombine(seed, *number);
+    }
+    if (auto number = std::get_if<uint64_t>(&data)) {
+        return hashCombine(seed, *number);
+    }
+    for (const auto &string : std::get<std::vector<std::string>>(data)) {
+        seed = hashString(string, seed);
+    }
+    return hashCombine(seed, std::get<std::vector<std::string>>(data).size());
+}
+
+/*!
+ * \brief Hash of whole instruction: keypath, value, type and data
+ */
+inline uint64_t hashInstruction(const PolicyInstruction &instruction, uint64_t seed = 0)
+{
+    return hashData(instruction.data,
+                    hashCombine(hashEntry(instruction.key, instruction.value, seed),
+                                static_cast<uint64_t>(instruction.type)));
+}
+
+/*!
+ * \brief Hasher of (keypath, value) pair for unordered containers
+ */
+struct PolicyEntryHash
+{
+    size_t operator()(const std::pair<std::string_view, std::string_view> &entry) const
+    {
+        return static_cast<size_t>(hashEntry(entry.first, entry.second));
+    }
+};
+
+} // namespace pol
+
+#endif // PREGPARSER_HASH
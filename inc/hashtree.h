@@ -0,0 +1,95 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_HASHTREE
+#define PREGPARSER_HASHTREE
+
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <parser.h>
+
+namespace pol {
+
+/*!
+ * \brief Node of PolicyHashTree: key with instructions of exactly this keypath (`own`) and
+ * subkeys ordered by lowercase name. `name` is spelled as first met.
+ */
+typedef struct PolicyHashNode
+{
+    PolicyHashNode() = default;
+    PolicyHashNode(PolicyHashNode &&) = default;
+    PolicyHashNode &operator=(PolicyHashNode &&) = default;
+    /*!
+     * \brief Subkeys are released without recursion, see `releaseSubtrees`
+     */
+    ~PolicyHashNode();
+
+    std::string name{};
+    /* Hash of own instructions in order */
+    uint64_t own{};
+    /* Hash of own instructions and all subkeys */
+    uint64_t hash{};
+    /* Instructions in subtree */
+    size_t count{};
+    std::map<std::string, std::unique_ptr<PolicyHashNode>, std::less<>> subkeys{};
+} PolicyHashNode;
+
+/*!
+ * \brief Merkle tree over keypath hierarchy of policy file. Two replicas compare root hashes
+ * and descend only into subkeys with differing hashes.
+ * Key and value names are compared ignoring ASCII case, like policy is applied. Order of
+ * instructions is significant within keypath, order between different keypaths is not.
+ * Instructions may be added while file is parsed (e.g. from `PRegPushParser` callback), hashes
+ * are computed by `finish`.
+ */
+class PolicyHashTree final
+{
+public:
+    static PolicyHashTree build(const PolicyFile &file);
+
+    void add(const PolicyInstruction &instruction);
+    /*!
+     * \brief Compute subtree hashes after instructions were added
+     */
+    void finish();
+
+    const PolicyHashNode &root() const;
+    uint64_t hash() const;
+    /*!
+     * \brief Find node by `\` separated keypath. Return nullptr if absent.
+     */
+    const PolicyHashNode *find(std::string_view keypath) const;
+    /*!
+     * \brief Keypaths of keys whose own instructions differ from `other`, and of topmost keys
+     * which exist only in one of trees. Descends only into subtrees with differing hashes.
+     */
+    std::vector<std::string> difference(const PolicyHashTree &other) const;
+
+private:
+    PolicyHashNode m_root{};
+    bool m_finished{ true };
+};
+
+} // namespace pol
+
+#endif // PREGPARSER_HASHTREE
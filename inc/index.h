@@ -0,0 +1,88 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_INDEX
+#define PREGPARSER_INDEX
+
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+#include <parser.h>
+
+namespace pol {
+
+typedef struct PolicyIndexEntry
+{
+    uint64_t hash{};
+    uint64_t offset{};
+} PolicyIndexEntry;
+
+/*!
+ * \brief Sidecar index of POL Registry file: hash of (keypath, value) -> instruction offset.
+ * Names are matched ignoring ASCII case.
+ * Binary form (all numbers are LE): `PIDX`, version (uint32_t), size of indexed file
+ * (uint64_t), count of entries (uint64_t), entries sorted by hash (uint64_t hash,
+ * uint64_t offset).
+ */
+class PolicyIndex final
+{
+public:
+    /*!
+     * \brief Build index by metadata scan of POL Registry file, data is not decoded
+     */
+    static PolicyIndex build(PRegParser &parser, std::istream &policy);
+    /*!
+     * \brief Read index in binary form. Throws an std::runtime_error on invalid index.
+     */
+    static PolicyIndex load(std::istream &stream);
+    /*!
+     * \brief Put index in binary form into stream
+     */
+    void save(std::ostream &stream) const;
+
+    /*!
+     * \brief Offsets of instructions which may have (keypath, value), in file order.
+     * Different pairs may share hash, so candidates must be checked.
+     */
+    std::vector<uint64_t> find(std::string_view keypath, std::string_view value) const;
+    /*!
+     * \brief Seek to and decode the last instruction with (keypath, value).
+     * Return empty optional if there is no such instruction.
+     */
+    std::optional<PolicyInstruction> lookup(PRegParser &parser, std::istream &policy,
+                                            std::string_view keypath,
+                                            std::string_view value) const;
+
+    /*!
+     * \brief Size of indexed file, can be used to detect stale index
+     */
+    inline uint64_t sourceSize() const { return m_sourceSize; }
+    inline size_t size() const { return m_entries.size(); }
+
+private:
+    uint64_t m_sourceSize{};
+    std::vector<PolicyIndexEntry> m_entries{};
+};
+
+} // namespace pol
+
+#endif // PREGPARSER_INDEX
@@ -0,0 +1,127 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_LAYOUT
+#define PREGPARSER_LAYOUT
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <hash.h>
+#include <parser.h>
+
+namespace pol {
+
+/*!
+ * \brief Alternatives of PolicyData, in order of its declaration
+ */
+enum class PolicyDataAlternative : uint8_t {
+    String = 0,
+    Strings = 1,
+    Binary = 2,
+    Dword = 3,
+    Qword = 4,
+};
+
+/*!
+ * \brief Shared encoding of PolicyData in alternative layouts of PolicyFile (PolicyCompactFile,
+ * PolicyColumns): strings in UTF-8, list of strings as strings each followed by '\0', integers
+ * in native byte order. Bytes are appended to `target`.
+ */
+void encodeData(const PolicyData &data, std::string &target);
+/*!
+ * \brief Decode data of `alternative` from bytes written by `encodeData`
+ */
+PolicyData decodeData(PolicyDataAlternative alternative, std::string_view bytes);
+/*!
+ * \brief DWORD or QWORD data from bytes written by `encodeData`, 0 for other alternatives
+ */
+uint64_t decodeInteger(PolicyDataAlternative alternative, std::string_view bytes);
+
+/*!
+ * \brief Find entry with the same bytes (read by `getBytes`) as `bytes` in `index` of interned
+ * entries by `hashString`. Return nullptr if there is none.
+ */
+template <typename Entry, typename GetBytes>
+inline const Entry *findInterned(const std::unordered_multimap<uint64_t, Entry> &index,
+                                 uint64_t hash, std::string_view bytes, GetBytes &&getBytes)
+{
+    auto range = index.equal_range(hash);
+
+    for (auto found = range.first; found != range.second; ++found) {
+        if (getBytes(found->second) == bytes) {
+            return &found->second;
+        }
+    }
+
+    return nullptr;
+}
+
+/*!
+ * \brief Intern `bytes` in `index`: return entry found by `findInterned`, or the new one made by
+ * `store`.
+ */
+template <typename Entry, typename GetBytes, typename Store>
+inline Entry intern(std::unordered_multimap<uint64_t, Entry> &index, std::string_view bytes,
+                    GetBytes &&getBytes, Store &&store)
+{
+    auto hash = hashString(bytes);
+
+    if (auto found = findInterned(index, hash, bytes, getBytes)) {
+        return *found;
+    }
+    return index.emplace(hash, store(bytes))->second;
+}
+
+/*!
+ * \brief Layout (see `PolicyCompactFile`, `PolicyColumns`) filled with instructions of `file`
+ */
+template <typename Layout>
+inline Layout makeLayout(const PolicyFile &file)
+{
+    Layout result;
+
+    result.reserve(file.instructions.size());
+    for (const auto &instruction : file.instructions) {
+        result.add(instruction);
+    }
+
+    return result;
+}
+
+/*!
+ * \brief PolicyFile decoded from all instructions of layout
+ */
+template <typename Layout>
+inline PolicyFile makeFile(const Layout &layout)
+{
+    PolicyFile file;
+
+    file.instructions.reserve(layout.size());
+    for (size_t i = 0; i < layout.size(); ++i) {
+        file.instructions.push_back(layout.instruction(i));
+    }
+
+    return file;
+}
+
+} // namespace pol
+
+#endif // PREGPARSER_LAYOUT
@@ -0,0 +1,69 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_LOADER
+#define PREGPARSER_LOADER
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace pol {
+
+/*!
+ * \brief Content of loaded file or error message
+ */
+typedef struct LoadedFile
+{
+    inline bool ok() const { return error.empty(); }
+
+    std::vector<uint8_t> data{};
+    std::string error{};
+} LoadedFile;
+
+/*!
+ * \brief Check that io_uring can be used by this process (Linux only, may be disabled by kernel
+ * configuration or seccomp)
+ */
+bool isIoUringAvailable();
+
+/*!
+ * \brief Receiver of loaded file and its index in paths
+ */
+typedef std::function<void(size_t index, LoadedFile &&file)> LoadCallback;
+
+/*!
+ * \brief Read many files into memory. On Linux reads of up to `queueDepth` files are submitted
+ * to io_uring at once and overlap each other; when io_uring is unavailable files are read one
+ * by one with `pread`.
+ * \return Files in order of `paths`. Errors do not stop loading of other files.
+ */
+std::vector<LoadedFile> loadFiles(const std::vector<std::string> &paths, size_t queueDepth = 64);
+/*!
+ * \brief Read many files like above, but pass every file to `callback` (on the calling thread)
+ * as soon as it is read, in order of completion. Only files being read are kept in memory.
+ * If reading stops by exception (of callback too), reads in flight are waited for before their
+ * buffers are released.
+ */
+void loadFiles(const std::vector<std::string> &paths, const LoadCallback &callback,
+               size_t queueDepth = 64);
+
+} // namespace pol
+
+#endif // PREGPARSER_LOADER
@@ -0,0 +1,85 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_PARALLEL
+#define PREGPARSER_PARALLEL
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <parser.h>
+
+namespace pol {
+
+/*!
+ * \brief Parse POL Registry file in memory using `threads` threads (0 - one per hardware thread).
+ * Instructions are found by `scanInstructions`, then ranges of them are materialized on worker
+ * threads, each with its own iconv descriptors, into tree allocated once. Order of instructions
+ * is preserved. If materialization fails, error of the first malformed instruction is thrown.
+ * `limits` are checked for whole file before anything is decoded. Fingerprint (see
+ * `ParseOptions`) is recorded by tasks and summed.
+ */
+PolicyFile parseParallel(const uint8_t *data, size_t size, size_t threads = 0,
+                         const ParseLimits &limits = {}, const ParseOptions &options = {});
+
+typedef struct ParseManyOptions
+{
+    /* Count of worker threads, 0 - one per hardware thread */
+    size_t threads{};
+    /* If set, only accepted instructions are parsed. Every worker thread calls its own copy of
+     * filter, state shared by copies (captured by reference or pointer) must be safe to use
+     * concurrently. */
+    PolicyFilter filter{};
+    /* Load files by `loadFiles` (io_uring if available) on the calling thread, every file is
+     * parsed as soon as it is read and released after parse */
+    bool batchRead{};
+    /* Limits of every file parse */
+    ParseLimits limits{};
+    /* Options of every file parse */
+    ParseOptions parse{};
+} ParseManyOptions;
+
+/*!
+ * \brief Result of parsing one of many files: parsed file or error message
+ */
+typedef struct ParseResult
+{
+    inline bool ok() const { return file.has_value(); }
+
+    std::optional<PolicyFile> file{};
+    std::string error{};
+} ParseResult;
+
+/*!
+ * \brief Parse many POL Registry files on pool of worker threads, each with its own parser.
+ * Idle workers take next file from the shared queue, so slow files do not stall others.
+ * \return Results in order of `paths`. Errors do not stop parsing of other files.
+ */
+std::vector<ParseResult> parseMany(const std::vector<std::string> &paths,
+                                   const ParseManyOptions &options = {});
+/*!
+ * \brief Parse many POL Registry files in memory, same as `parseMany` for paths
+ */
+std::vector<ParseResult> parseMany(const std::vector<std::vector<uint8_t>> &buffers,
+                                   const ParseManyOptions &options = {});
+
+} // namespace pol
+
+#endif // PREGPARSER_PARALLEL
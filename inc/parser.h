@@ -20,16 +20,22 @@
 #ifndef PREGPARSER_PARSER
 #define PREGPARSER_PARSER
 
+#include <functional>
 #include <istream>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <variant>
 #include <vector>
 
 #include <iconv.h>
 
+#include <sink.h>
+#include <source.h>
+
 namespace pol {
 
 enum class PolicyRegType {
@@ -65,6 +71,25 @@ typedef std::variant<std::string, std::vector<std::string>, std::vector<uint8_t>
                      uint64_t>
         PolicyData;
 
+/*!
+ * \brief Original encoded bytes of instruction. `data` shares ownership of the parsed buffer,
+ * writer copies bytes verbatim while `data` is set (see `isRawValid`). Edits of
+ * PolicyInstruction fields are not tracked: whoever edits type, data, keypath or value of parsed
+ * instruction resets `raw` (`instruction.raw = {}`).
+ * `digest` is `hashInstruction` at parse time, recorded by debug builds only to catch edits
+ * which kept `raw`.
+ */
+typedef struct PolicyRawInstruction
+{
+    std::shared_ptr<const uint8_t> data{};
+    size_t size{};
+    uint64_t digest{};
+} PolicyRawInstruction;
+
+/*!
+ * \brief Decoded instruction. `raw` is not compared, it is set only by parse that keeps raw
+ * bytes.
+ */
 typedef struct PolicyInstruction
 {
     inline bool operator==(const PolicyInstruction &other) const
@@ -80,10 +105,65 @@ typedef struct PolicyInstruction
     PolicyData data{};
     std::string key{};
     std::string value{};
+    PolicyRawInstruction raw{};
 } PolicyInstruction;
 
 typedef std::vector<PolicyInstruction> PolicyTree;
 
+/*!
+ * \brief Instruction description without data. Offsets are positions in source stream.
+ */
+typedef struct PolicyInstructionInfo
+{
+    PolicyRegType type{};
+    uint32_t size{};
+    uint64_t offset{};
+    uint64_t dataOffset{};
+    std::string key{};
+    std::string value{};
+} PolicyInstructionInfo;
+
+/*!
+ * \brief Position of instruction parts in raw buffer, offsets are counted from buffer begin.
+ * Keypath begins right after `[` (at `offset + 2`), sizes of keypath and value are in bytes
+ * and do not include terminating '\0'.
+ */
+typedef struct PolicyInstructionBounds
+{
+    size_t offset{};
+    size_t valueOffset{};
+    size_t dataOffset{};
+    uint32_t keypathSize{};
+    uint32_t valueSize{};
+    uint32_t size{};
+    PolicyRegType type{};
+} PolicyInstructionBounds;
+
+/*!
+ * \brief Order-insensitive 128-bit fingerprint of instructions: two sums (modulo 2^64) of
+ * `hashInstruction` over all instructions, with different seeds. Equal multisets of
+ * instructions have equal fingerprints whatever their order, fingerprints of parts are
+ * combined by `merge`.
+ */
+typedef struct PolicyFingerprint
+{
+    inline bool operator==(const PolicyFingerprint &other) const
+    {
+        return low == other.low && high == other.high;
+    }
+    inline bool operator!=(const PolicyFingerprint &other) const { return !(*this == other); }
+
+    void add(const PolicyInstruction &instruction);
+    inline void merge(const PolicyFingerprint &other)
+    {
+        low += other.low;
+        high += other.high;
+    }
+
+    uint64_t low{};
+    uint64_t high{};
+} PolicyFingerprint;
+
 typedef struct PolicyFile
 {
     inline bool operator==(const PolicyFile &other) const
@@ -95,93 +175,343 @@ typedef struct PolicyFile
         return instructions != other.instructions;
     }
 
+    /*!
+     * \brief Fingerprint of instructions: `parsedFingerprint` if it is recorded, otherwise it is
+     * computed from scratch (see `computeFingerprint`)
+     */
+    PolicyFingerprint fingerprint() const;
+
     PolicyTree instructions{};
+    /* Fingerprint of instructions as they were parsed (see `ParseOptions`). Edits are not
+     * tracked: library functions modifying the file reset it, whoever edits `instructions`
+     * directly resets it too, like `PolicyInstruction::raw`. */
+    std::optional<PolicyFingerprint> parsedFingerprint{};
 } PolicyFile;
 
+/*!
+ * \brief Fingerprint of instructions computed from scratch
+ */
+PolicyFingerprint computeFingerprint(const PolicyTree &instructions);
+
+/*!
+ * \brief Predicate over instruction keypath and value. Instructions rejected by the filter are
+ * skipped by parser without reading their data.
+ */
+typedef std::function<bool(std::string_view keypath, std::string_view value)> PolicyFilter;
+
+/*!
+ * \brief Limits of single parse, protect from hostile files. Instruction sizes are counted in
+ * binary form, brackets and separators included. Memory is estimated by `getDecodedSize` and
+ * `getStringsOverhead`. Declared sizes are checked before any allocation.
+ */
+typedef struct ParseLimits
+{
+    /* Max size of single instruction */
+    uint64_t maxInstructionSize = std::numeric_limits<uint64_t>::max();
+    /* Memory budget of parse: max memory taken by decoded instructions */
+    uint64_t maxTotalSize = std::numeric_limits<uint64_t>::max();
+    /* Max count of instructions */
+    uint64_t maxInstructionCount = std::numeric_limits<uint64_t>::max();
+} ParseLimits;
+
+/*!
+ * \brief Resources consumed by parse, checked against `ParseLimits`
+ */
+typedef struct ParseUsage
+{
+    uint64_t instructions{};
+    uint64_t memory{};
+} ParseUsage;
+
+/*!
+ * \brief Memory taken by decoded instruction, except elements of string lists: instruction
+ * itself, keypath, value and data. Sizes are in bytes of binary form, UTF-16 strings are
+ * assumed to take up to 3 bytes per symbol in UTF-8.
+ */
+uint64_t getDecodedSize(uint64_t keypathSize, uint64_t valueSize, PolicyRegType type,
+                        uint64_t dataSize);
+
+/*!
+ * \brief Memory taken by elements of string list in `data`, one std::string per terminator.
+ * Zero for other types. Empty strings take no data, but still take their element.
+ */
+uint64_t getStringsOverhead(PolicyRegType type, const uint8_t *data, uint64_t size);
+
+/*!
+ * \brief Account instruction of `instructionSize` bytes, taking `memorySize` bytes decoded,
+ * in `usage`. Throws an std::runtime_error if `limits` are exceeded.
+ */
+void checkLimits(const ParseLimits &limits, ParseUsage &usage, uint64_t instructionSize,
+                 uint64_t memorySize);
+
+/*!
+ * \brief Account instruction found by `scanInstructions` in `data`, string lists included
+ */
+void checkLimits(const ParseLimits &limits, ParseUsage &usage, const uint8_t *data,
+                 const PolicyInstructionBounds &bounds);
+
+/*!
+ * \brief Account `memorySize` more bytes in `usage`, see `checkLimits`
+ */
+void chargeMemory(const ParseLimits &limits, ParseUsage &usage, uint64_t memorySize);
+
+/*!
+ * \brief Options of parsing PolicyFile
+ */
+typedef struct ParseOptions
+{
+    /* Record `PolicyFile::parsedFingerprint` while instructions are decoded */
+    bool fingerprint{};
+} ParseOptions;
+
+/*!
+ * \brief Options of writing PolicyFile in binary form
+ */
+typedef struct WriteOptions
+{
+    /* Write instructions in canonical order, see `canonicalOrder` */
+    bool canonical{};
+} WriteOptions;
+
+/*!
+ * \brief Check that instruction keeps raw bytes, i.e. it was not modified after parse (see
+ * `PolicyRawInstruction`). Debug builds assert that instruction still matches `raw.digest`.
+ */
+bool isRawValid(const PolicyInstruction &instruction);
+
+/*!
+ * \brief Filter accepting instructions which keypath is `prefix` or one of its subkeys
+ * (ASCII case-insensitive, like registry does)
+ */
+PolicyFilter keypathPrefixFilter(std::string prefix);
+
+/*!
+ * \brief Check header `\x50\x52\x65\x67\x01\x00\x00\x00` at the beginning of buffer.
+ * Throws an std::runtime_error on invalid header.
+ * \return false if buffer is shorter than header
+ */
+bool scanHeader(const uint8_t *data, size_t size);
+/*!
+ * \brief Find bounds of instruction which begins at `offset` of buffer. Only structure is checked
+ * (separators, terminators and sizes), characters are validated by `PRegParser::materialize`.
+ * Throws an std::runtime_error on malformed instruction.
+ * \return false if buffer ends before instruction does. Then `bounds.dataOffset` and
+ * `bounds.size` locate data if size of data was read, otherwise `bounds.dataOffset` is 0.
+ */
+bool scanInstruction(const uint8_t *data, size_t size, size_t offset,
+                     PolicyInstructionBounds &bounds);
+/*!
+ * \brief Structural pass over whole POL Registry file in memory: check header and find bounds
+ * of every instruction. Throws an std::runtime_error on malformed or truncated file.
+ */
+std::vector<PolicyInstructionBounds> scanInstructions(const uint8_t *data, size_t size);
+
 class PRegParser final
 {
 private:
     /*!
      * \brief Check regex `\x50\x52\x65\x67\x01\x00\x00\x00`
      */
-    void parseHeader(std::istream &stream);
+    template <typename Source>
+    void parseHeader(Source &source);
     /*!
      * \brief Check regex `(.{4})` and return first group as uint32_t (LE, it will be converted to
      * native)
      */
-    uint32_t getSize(std::istream &stream);
+    template <typename Source>
+    uint32_t getSize(Source &source);
     /*!
-     * \brief Convert binary data from stream to PolicyData
+     * \brief Convert binary data from source to PolicyData
      */
-    PolicyData getData(std::istream &stream, PolicyRegType type, uint32_t size);
+    template <typename Source>
+    PolicyData getData(Source &source, PolicyRegType type, uint32_t size);
     /*!
      * \brief Check 32bit LE regex `([\x1\x2\x3\x4\x5\x6\x7\x8\x9\xA\xB\xC])` and return first
      * group as Type
      */
-    PolicyRegType getType(std::istream &stream);
-    /*!
-     * \brief Matches regex `([\x20-\x5B\x5D-\x7E]\x00)+` and return
-     * string as result (UTF-16LE will be converted to UTF-8)
-     */
-    std::string getKey(std::istream &stream);
+    template <typename Source>
+    PolicyRegType getType(Source &source);
     /*!
      * \brief Matches regex
      * `((:?([\x20-\x5B\x5D-\x7E]\x00)+)(:?\x5C\x00([\x20-\x5B\x5D-\x7E]\x00)+)+)` and return first
      * group as result
      */
-    std::string getKeypath(std::istream &stream);
+    template <typename Source>
+    std::string getKeypath(Source &source);
     /*!
      * \brief Matches regex `((:?[\x20-\x7E]\x00){1,259})` and return first group as result
      * (UTF-16LE will be converted to UTF-8)
      */
-    std::string getValue(std::istream &stream);
+    template <typename Source>
+    std::string getValue(Source &source);
     /*!
-     * \brief Matches ABNF `LBracket KeyPath SC Value SC Type SC Size SC Data RBracket`,
-     * where LBracket `\x5B\x00`, RBracket `\x5D\x00`, SC `\x3B\x00`. Return reduced structure
+     * \brief Matches the same regex as `getKeypath(Source &)` over `size` bytes of memory
      */
-    void insertInstruction(std::istream &stream, PolicyTree &tree);
-
+    std::string getKeypath(const uint8_t *data, size_t size);
     /*!
-     * \brief Matches regex `([\x20-\x5B\x5D-\x7E]\x00)+` and throws an
-     * std::runtime_error if it completely does not match the regex
+     * \brief Matches the same regex as `getValue(Source &)` over `size` bytes of memory
      */
-    void validateKey(std::string::const_iterator &begin, std::string::const_iterator &end);
+    std::string getValue(const uint8_t *data, size_t size);
     /*!
-     * \brief Matches regex
-     * `((:?([\x20-\x5B\x5D-\x7E]\x00)+)(:?\x5C\x00([\x20-\x5B\x5D-\x7E]\x00)+)+)` and throws an
-     * std::runtime_error if it completely does not match the regex
+     * \brief Convert binary data from memory to PolicyData
      */
-    void validateKeypath(std::string::const_iterator begin, std::string::const_iterator end);
+    PolicyData getData(const uint8_t *data, PolicyRegType type, uint32_t size);
     /*!
-     * \brief Matches regex `((:?[\x20-\x7E]\x00){1,259})` and throws an
-     * std::runtime_error if it completely does not match the regex
+     * \brief Validate type and decode data of instruction found by `scanInstruction`
      */
-    void validateValue(std::string::const_iterator begin, std::string::const_iterator end);
+    void materializeData(const uint8_t *data, const PolicyInstructionBounds &bounds,
+                         PolicyInstruction &instruction);
+    /*!
+     * \brief Matches ABNF `LBracket KeyPath SC Value SC Type SC Size SC Data RBracket`,
+     * where LBracket `\x5B\x00`, RBracket `\x5D\x00`, SC `\x3B\x00`. Return reduced structure.
+     * If `filter` is set and rejects instruction, its data is skipped and nothing is inserted.
+     */
+    template <typename Source>
+    void insertInstruction(Source &source, PolicyTree &tree, const PolicyFilter &filter);
+    /*!
+     * \brief Matches the same ABNF as `insertInstruction`, but skip data and insert only
+     * instruction description. Offsets are counted from `base`.
+     */
+    template <typename Source>
+    void insertInstructionInfo(Source &source, uint64_t base,
+                               std::vector<PolicyInstructionInfo> &infos);
+
     /*!
      * \brief Validate type and throw an std::runtime_error if it is invalid
      */
     void validateType(PolicyRegType type);
     /*!
-     * \brief Put `\x50\x52\x65\x67\x01\x00\x00\x00` into stream
+     * \brief Put `\x50\x52\x65\x67\x01\x00\x00\x00` into sink
      */
-    void writeHeader(std::ostream &stream);
+    template <typename Sink>
+    void writeHeader(Sink &sink);
     /*!
      * \brief Put instruction, with ABNF
      * `LBracket KeyPath SC Value SC Type SC Size SC Data RBracket`,
-     * where LBracket `\x5B\x00`, RBracket `\x5D\x00`, SC `\x3B\x00`, into stream.
+     * where LBracket `\x5B\x00`, RBracket `\x5D\x00`, SC `\x3B\x00`, into sink.
      */
-    void writeInstruction(std::ostream &stream, const PolicyInstruction &instruction,
-                          std::string key, std::string value);
+    template <typename Sink>
+    void writeInstruction(Sink &sink, const PolicyInstruction &instruction);
+    /*!
+     * \brief Positions of instructions in written order by `m_writeOptions`, empty if file
+     * order is kept
+     */
+    std::optional<std::vector<size_t>> getWriteOrder(const PolicyFile &file);
+    /*!
+     * \brief Put header and instructions of `file` in `order` into sink
+     */
+    template <typename Sink>
+    void writeFile(Sink &sink, const PolicyFile &file,
+                   const std::optional<std::vector<size_t>> &order);
+    size_t getFileSize(const PolicyFile &file, const std::optional<std::vector<size_t>> &order);
 
     /*!
-     * \brief Put PolicyRegData by PolicyRegType into stringstream
+     * \brief Compute size of PolicyRegData by PolicyRegType in its binary form, without encoding
+     */
+    uint32_t getDataSize(const PolicyData &data, PolicyRegType type);
+    /*!
+     * \brief Compute size of instruction in its binary form, without encoding
+     */
+    size_t getInstructionSize(const PolicyInstruction &instruction);
+    /*!
+     * \brief Account all instructions of file in memory in `m_usage`
      */
-    std::stringstream getDataStream(const PolicyData &data, PolicyRegType type);
+    void accountInstructions(const uint8_t *data,
+                             const std::vector<PolicyInstructionBounds> &bounds);
+    /*!
+     * \brief Add decoded instruction to fingerprint of current parse, if it is recorded
+     */
+    void recordInstruction(const PolicyInstruction &instruction);
+    /*!
+     * \brief Make parsed file, with fingerprint if it is recorded
+     */
+    PolicyFile finishParse(PolicyTree &&instructions);
+    /*!
+     * \brief Put PolicyRegData by PolicyRegType into sink
+     */
+    template <typename Sink>
+    void writeData(Sink &sink, const PolicyData &data, PolicyRegType type);
 
 public:
     PRegParser();
+    /*!
+     * \brief Set limits applied to every following parse, unlimited by default
+     */
+    void setLimits(const ParseLimits &limits);
+    const ParseLimits &getLimits() const;
+    /*!
+     * \brief Set options applied to every following parse
+     */
+    void setParseOptions(const ParseOptions &options);
+    const ParseOptions &getParseOptions() const;
+    /*!
+     * \brief Set options applied to every following write, file order is kept by default
+     */
+    void setWriteOptions(const WriteOptions &options);
+    const WriteOptions &getWriteOptions() const;
     PolicyFile parse(std::istream &stream);
+    /*!
+     * \brief Parse only instructions accepted by `filter`
+     */
+    PolicyFile parse(std::istream &stream, const PolicyFilter &filter);
+    /*!
+     * \brief List keypath, value, type, data size and offsets of every instruction, data is not
+     * read. Stream must support `tellg`.
+     */
+    std::vector<PolicyInstructionInfo> scanMetadata(std::istream &stream);
+    /*!
+     * \brief Parse single instruction from current position of stream
+     */
+    PolicyInstruction parseInstruction(std::istream &stream);
+    /*!
+     * \brief Parse POL Registry file in memory in two passes: `scanInstructions` finds
+     * instructions, then they are materialized into tree reserved once.
+     */
+    PolicyFile parse(const uint8_t *data, size_t size);
+    /*!
+     * \brief Parse only instructions accepted by `filter` from POL Registry file in memory
+     */
+    PolicyFile parse(const uint8_t *data, size_t size, const PolicyFilter &filter);
+    /*!
+     * \brief Parse POL Registry file in memory like `parse(data, size)` and keep raw bytes of
+     * every instruction (see `PolicyRawInstruction`). `owner` keeps `data` alive, it is shared
+     * with instructions. Unmodified instructions are written back verbatim, so edit-and-save
+     * does not encode them again and round trip is byte-identical.
+     */
+    PolicyFile parse(std::shared_ptr<const void> owner, const uint8_t *data, size_t size);
+    /*!
+     * \brief Validate and decode instruction found by `scanInstruction` in `data`. Limits are
+     * not checked, caller accounts instructions by `checkLimits`.
+     */
+    PolicyInstruction materialize(const uint8_t *data, const PolicyInstructionBounds &bounds);
+    /*!
+     * \brief Parse POL Registry file from byte source, see `source.h`. Instantiated for
+     * `BufferSource`, `MmapSource`, `StreamSource` and `FdSource`.
+     */
+    template <typename Source>
+    PolicyFile parseFrom(Source &source, const PolicyFilter &filter = {});
     bool write(std::ostream &stream, const PolicyFile &file);
+    /*!
+     * \brief Put `file` in binary form into byte sink, see `sink.h`. Sink is flushed.
+     * Instantiated for `BufferSink`, `VectorSink`, `StreamSink`, `FdSink`, `StreamOutput` and
+     * `FdOutput`.
+     */
+    template <typename Sink>
+    void writeTo(Sink &sink, const PolicyFile &file);
+    /*!
+     * \brief Exact size of `file` in binary form (header included)
+     */
+    size_t serializedSize(const PolicyFile &file);
+    /*!
+     * \brief Put `file` in binary form into `out`. Throws an std::runtime_error if `capacity` is
+     * less than `serializedSize(file)`.
+     * \return Count of written bytes
+     */
+    size_t serializeInto(const PolicyFile &file, uint8_t *out, size_t capacity);
+    /*!
+     * \brief Put `file` in binary form into buffer allocated once with exact size
+     */
+    std::vector<uint8_t> serialize(const PolicyFile &file);
     ~PRegParser();
 
 private:
@@ -190,6 +520,12 @@ private:
 
     ::iconv_t m_iconvReadId{};
     ::iconv_t m_iconvWriteId{};
+    ParseLimits m_limits{};
+    ParseUsage m_usage{};
+    ParseOptions m_parseOptions{};
+    /* Fingerprint of current parse */
+    PolicyFingerprint m_fingerprint{};
+    WriteOptions m_writeOptions{};
 };
 
 std::unique_ptr<PRegParser> createPregParser();
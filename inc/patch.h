@@ -0,0 +1,64 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_PATCH
+#define PREGPARSER_PATCH
+
+#include <vector>
+
+#include <parser.h>
+
+namespace pol {
+
+/*!
+ * \brief Make patch which turns encoded POL Registry file `base` into `target`.
+ * Both files are only scanned (see `scanInstructions`), instructions are compared as raw bytes.
+ * Runs of instructions found in `base` are referenced as byte ranges of it, the rest is stored
+ * encoded. Throws an std::runtime_error on malformed file.
+ * Patch format (little endian):
+ *  `PPAT`, version (uint32), size and `hashBytes` of base and target (uint64 each),
+ *  operation count (uint64), then operations: kind (uint8) and
+ *    0 - copy: offset and size of base range (uint64 each);
+ *    1 - literal: size (uint64) and bytes.
+ */
+std::vector<uint8_t> makePatch(const uint8_t *base, size_t baseSize, const uint8_t *target,
+                               size_t targetSize);
+/*!
+ * \brief Apply patch made by `makePatch` to `base`. Neither of files is decoded or scanned.
+ * Throws an std::runtime_error on malformed patch or when base or result does not match
+ * digests stored in patch.
+ */
+std::vector<uint8_t> applyPatch(const uint8_t *base, size_t baseSize, const uint8_t *patch,
+                                size_t patchSize);
+
+inline std::vector<uint8_t> makePatch(const std::vector<uint8_t> &base,
+                                      const std::vector<uint8_t> &target)
+{
+    return makePatch(base.data(), base.size(), target.data(), target.size());
+}
+
+inline std::vector<uint8_t> applyPatch(const std::vector<uint8_t> &base,
+                                       const std::vector<uint8_t> &patch)
+{
+    return applyPatch(base.data(), base.size(), patch.data(), patch.size());
+}
+
+} // namespace pol
+
+#endif // PREGPARSER_PATCH
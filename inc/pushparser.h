@@ -0,0 +1,87 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_PUSHPARSER
+#define PREGPARSER_PUSHPARSER
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <parser.h>
+
+namespace pol {
+
+/*!
+ * \brief Incremental parser of POL Registry file for chunked input (sockets, pipes,
+ * decompression streams). Chunks may split file at any byte, incomplete instruction is kept
+ * between `feed` calls and every complete instruction is passed to callback as soon as it
+ * arrives. After an exception was thrown the parser must not be used anymore.
+ */
+class PRegPushParser final
+{
+public:
+    typedef std::function<void(PolicyInstruction &&instruction)> Callback;
+
+    explicit PRegPushParser(Callback callback, const ParseLimits &limits = {});
+
+    /*!
+     * \brief Parse next chunk of file. Incomplete instruction is kept until next chunk, it
+     * throws an std::runtime_error as soon as it can not fit `maxInstructionSize`.
+     */
+    void feed(const uint8_t *data, size_t size);
+    /*!
+     * \brief Check that input ended at the end of instruction, throws an std::runtime_error if
+     * file is truncated.
+     */
+    void finish();
+
+private:
+    PRegPushParser(const PRegPushParser &) = delete;
+    void operator=(const PRegPushParser &) = delete;
+
+    /*!
+     * \brief Emit complete instructions from `data`, return count of consumed bytes
+     */
+    size_t consume(const uint8_t *data, size_t size);
+    /*!
+     * \brief Remember how much of incomplete instruction found by `scanInstruction` must arrive
+     * before it is scanned again (`m_needed`)
+     */
+    void expect(const uint8_t *data, size_t size, const PolicyInstructionBounds &bounds);
+    /*!
+     * \brief Rest of pending instruction has not arrived yet, bytes up to `scanned` were already
+     * scanned. Pending bytes are not rescanned on every chunk.
+     */
+    bool isWaiting(size_t scanned) const;
+
+    Callback m_callback{};
+    std::unique_ptr<PRegParser> m_parser{};
+    std::vector<uint8_t> m_pending{};
+    /* Size pending bytes must reach before they are scanned again, 0 while `\0` of keypath or
+     * value is awaited */
+    size_t m_needed{};
+    bool m_header{};
+    ParseLimits m_limits{};
+    ParseUsage m_usage{};
+};
+
+} // namespace pol
+
+#endif // PREGPARSER_PUSHPARSER
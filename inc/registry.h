@@ -0,0 +1,99 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_REGISTRY
+#define PREGPARSER_REGISTRY
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <parser.h>
+
+namespace pol {
+
+typedef struct RegistryValue
+{
+    std::string name{};
+    PolicyRegType type{};
+    PolicyData data{};
+} RegistryValue;
+
+/*!
+ * \brief Registry key node. Subkeys and values are indexed by lowercase name (registry names
+ * are case-insensitive), original spelling is kept in `name`.
+ */
+typedef struct RegistryKey
+{
+    RegistryKey() = default;
+    RegistryKey(RegistryKey &&) = default;
+    RegistryKey &operator=(RegistryKey &&) = default;
+    /*!
+     * \brief Subkeys are released without recursion, see `releaseSubtrees`
+     */
+    ~RegistryKey();
+
+    std::string name{};
+    bool secure{};
+    std::unordered_map<std::string, std::unique_ptr<RegistryKey>> subkeys{};
+    std::unordered_map<std::string, RegistryValue> values{};
+} RegistryKey;
+
+/*!
+ * \brief In-memory registry tree. Applies instructions of Registry.pol in order, interpreting
+ * special value names:
+ *  `**del.<value>`  - delete value;
+ *  `**delvals.`     - delete all values of the key;
+ *  `**DeleteValues` - delete values listed in REG_SZ data (`;` separated);
+ *  `**DeleteKeys`   - delete subkeys listed in REG_SZ data (`;` separated);
+ *  `**SecureKey`    - set key security flag from DWORD data;
+ *  `**soft.<value>` - create value only if it does not exist.
+ * Empty value name only creates the key.
+ */
+class RegistryModel final
+{
+public:
+    void apply(const PolicyFile &file);
+    void apply(const PolicyInstruction &instruction);
+    void clear();
+
+    const RegistryKey &root() const;
+    /*!
+     * \brief Find key by keypath (`\` separated, case-insensitive). Return nullptr if absent.
+     */
+    const RegistryKey *findKey(std::string_view keypath) const;
+    /*!
+     * \brief Find value by keypath and value name. Return nullptr if absent.
+     */
+    const RegistryValue *findValue(std::string_view keypath, std::string_view value) const;
+
+private:
+    RegistryKey &createKey(std::string_view keypath);
+    RegistryKey *lookupKey(std::string_view keypath) const;
+    void deleteKey(RegistryKey &parent, std::string_view keypath);
+    void setValue(RegistryKey &key, std::string_view name, const PolicyInstruction &instruction,
+                  bool soft);
+
+    RegistryKey m_root{};
+};
+
+} // namespace pol
+
+#endif // PREGPARSER_REGISTRY
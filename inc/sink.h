@@ -0,0 +1,213 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_SINK
+#define PREGPARSER_SINK
+
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <encoding.h>
+
+namespace pol {
+
+/*
+ * Byte sinks of the writer. Every sink provides:
+ *  `void write(const uint8_t *data, size_t size)` - append bytes, throws an std::runtime_error
+ *                                                   on error;
+ *  `void flush()`                                 - pass buffered bytes to the destination.
+ * Methods are not virtual: writer is instantiated for every sink.
+ */
+
+/*!
+ * \brief Sink over fixed memory region. Overflow throws an std::runtime_error.
+ */
+class BufferSink final
+{
+public:
+    BufferSink(uint8_t *data, size_t capacity) : m_data(data), m_capacity(capacity) { }
+
+    inline size_t written() const { return m_size; }
+
+    inline void write(const uint8_t *data, size_t size)
+    {
+        if (size > m_capacity - m_size) {
+            throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                     + ", Output buffer is too small.");
+        }
+
+        memcpy(m_data + m_size, data, size);
+        m_size += size;
+    }
+    inline void flush() { }
+
+private:
+    uint8_t *m_data;
+    size_t m_capacity;
+    size_t m_size{};
+};
+
+/*!
+ * \brief Sink appending to growing vector
+ */
+class VectorSink final
+{
+public:
+    explicit VectorSink(std::vector<uint8_t> &target) : m_target(target) { }
+
+    inline void write(const uint8_t *data, size_t size)
+    {
+        m_target.insert(m_target.end(), data, data + size);
+    }
+    inline void flush() { }
+
+private:
+    std::vector<uint8_t> &m_target;
+};
+
+/*!
+ * \brief Output of `BlockSink` over std::ostream, also unbuffered sink itself
+ */
+class StreamOutput final
+{
+public:
+    StreamOutput(std::ostream &stream) : m_stream(stream) { }
+
+    inline void write(const uint8_t *data, size_t size)
+    {
+        m_stream.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(size));
+        if (m_stream.fail()) {
+            throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                     + ", Failed to write buffer, error was encountered.");
+        }
+    }
+    inline void flush() { }
+
+private:
+    std::ostream &m_stream;
+};
+
+/*!
+ * \brief Output of `BlockSink` over file descriptor, also unbuffered sink itself. Descriptor
+ * is not closed.
+ */
+class FdOutput final
+{
+public:
+    FdOutput(int fd) : m_fd(fd) { }
+
+    void write(const uint8_t *data, size_t size);
+    inline void flush() { }
+
+private:
+    int m_fd;
+};
+
+/*!
+ * \brief Block-buffered sink. Bytes are collected into blocks of `block_size` bytes before
+ * they are passed to `Output`. Destructor flushes remaining bytes and ignores errors, call
+ * `flush()` to get them.
+ */
+template <typename Output>
+class BlockSink final
+{
+public:
+    static const size_t block_size = 64 * 1024;
+
+    explicit BlockSink(Output output, size_t blockSize = block_size)
+        : m_output(output), m_buffer(blockSize)
+    {
+    }
+    ~BlockSink()
+    {
+        try {
+            flush();
+        } catch (...) {
+        }
+    }
+
+    inline void write(const uint8_t *data, size_t size)
+    {
+        if (size > m_buffer.size() - m_size) {
+            flush();
+
+            // Large writes bypass the block.
+            if (size >= m_buffer.size()) {
+                m_output.write(data, size);
+                return;
+            }
+        }
+
+        memcpy(m_buffer.data() + m_size, data, size);
+        m_size += size;
+    }
+    void flush()
+    {
+        if (m_size != 0) {
+            // Block is dropped even on error, so destructor does not repeat it.
+            auto size = m_size;
+            m_size = 0;
+            m_output.write(m_buffer.data(), size);
+        }
+    }
+
+private:
+    BlockSink(const BlockSink &) = delete;
+    void operator=(const BlockSink &) = delete;
+
+    Output m_output;
+    std::vector<uint8_t> m_buffer{};
+    size_t m_size{};
+};
+
+typedef BlockSink<StreamOutput> StreamSink;
+typedef BlockSink<FdOutput> FdSink;
+
+/*!
+ * \brief Put UTF-16LE symbol to sink
+ */
+template <typename Sink>
+inline void writeSymbol(Sink &sink, char16_t sym)
+{
+    uint16_t data = nativeToLe<uint16_t>(sym);
+
+    sink.write(reinterpret_cast<const uint8_t *>(&data), sizeof(data));
+}
+
+/*!
+ * \brief Put integral number to sink (binary)
+ */
+template <typename T, bool LE = true, typename Sink>
+inline void writeIntegral(Sink &sink, T num)
+{
+    if constexpr (LE) {
+        num = nativeToLe<T>(num);
+    } else {
+        num = nativeToBe<T>(num);
+    }
+
+    sink.write(reinterpret_cast<const uint8_t *>(&num), sizeof(T));
+}
+
+} // namespace pol
+
+#endif // PREGPARSER_SINK
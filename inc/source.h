@@ -0,0 +1,306 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_SOURCE
+#define PREGPARSER_SOURCE
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <encoding.h>
+
+namespace pol {
+
+/*
+ * Byte sources of the parser. Every source provides:
+ *  `const uint8_t *require(size_t size)` - pointer to `size` contiguous bytes, bytes are
+ *                                          consumed, throws an std::runtime_error on EOF;
+ *  `void skip(size_t size)`              - consume `size` bytes without storing them;
+ *  `bool eof()`                          - check that all data was read;
+ *  `uint64_t position() const`           - count of bytes consumed since construction.
+ * Methods are not virtual: parser is instantiated for every source, so bounds checks and loads
+ * are inlined into it.
+ */
+
+[[noreturn]] inline void throwSourceEof()
+{
+    throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                             + ", Failed to read buffer, EOF was encountered.");
+}
+
+/*!
+ * \brief Source over memory region, memory must outlive the source
+ */
+class BufferSource
+{
+public:
+    BufferSource(const uint8_t *data, size_t size) : m_data(data), m_size(size) { }
+
+    /*!
+     * \brief Whole memory region of the source
+     */
+    inline const uint8_t *data() const { return m_data; }
+    inline size_t size() const { return m_size; }
+
+    inline bool eof() const { return m_offset == m_size; }
+    inline uint64_t position() const { return m_offset; }
+
+    inline const uint8_t *require(size_t size)
+    {
+        if (size > m_size - m_offset) {
+            throwSourceEof();
+        }
+
+        auto result = m_data + m_offset;
+        m_offset += size;
+        return result;
+    }
+    inline void skip(size_t size) { require(size); }
+
+protected:
+    BufferSource() = default;
+
+    inline void reset(const uint8_t *data, size_t size)
+    {
+        m_data = data;
+        m_size = size;
+        m_offset = 0;
+    }
+
+private:
+    const uint8_t *m_data{};
+    size_t m_size{};
+    size_t m_offset{};
+};
+
+/*!
+ * \brief Source over memory mapped file. Throws an std::runtime_error if file can not be mapped.
+ */
+class MmapSource final : public BufferSource
+{
+public:
+    explicit MmapSource(const std::string &path);
+    ~MmapSource();
+
+private:
+    MmapSource(const MmapSource &) = delete;
+    void operator=(const MmapSource &) = delete;
+
+    void *m_mapping{};
+    size_t m_mappingSize{};
+};
+
+/*!
+ * \brief Input of `BlockSource` over std::istream. Unread bytes are returned to the stream if
+ * the stream supports seeking.
+ */
+class StreamInput final
+{
+public:
+    StreamInput(std::istream &stream) : m_stream(stream) { }
+
+    inline size_t read(uint8_t *data, size_t size)
+    {
+        m_stream.read(reinterpret_cast<char *>(data), static_cast<std::streamsize>(size));
+        auto count = static_cast<size_t>(m_stream.gcount());
+
+        // Short read at the end of stream is not an error for block source.
+        if (m_stream.eof()) {
+            m_stream.clear(std::ios::eofbit);
+        } else if (m_stream.fail()) {
+            throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                     + ", Failed to read buffer, error was encountered.");
+        }
+
+        return count;
+    }
+
+    inline void unread(size_t size) noexcept
+    {
+        auto state = m_stream.rdstate();
+        try {
+            m_stream.clear();
+            m_stream.seekg(-static_cast<std::streamoff>(size), std::ios::cur);
+            if (m_stream.fail()) {
+                // Stream is not seekable, read ahead data is lost.
+                m_stream.clear(state);
+            }
+        } catch (...) {
+            m_stream.clear(state);
+        }
+    }
+
+private:
+    std::istream &m_stream;
+};
+
+/*!
+ * \brief Input of `BlockSource` over file descriptor, descriptor is not closed. Unread bytes
+ * are returned with `lseek` if descriptor supports seeking.
+ */
+class FdInput final
+{
+public:
+    FdInput(int fd) : m_fd(fd) { }
+
+    size_t read(uint8_t *data, size_t size);
+    void unread(size_t size) noexcept;
+
+private:
+    int m_fd;
+};
+
+/*!
+ * \brief Block-buffered source. `Input` is read by blocks of `block_size` bytes and parser is
+ * served from memory, so the input does not need to be seekable. Unread part of the last block
+ * is returned to the input on destruction.
+ */
+template <typename Input>
+class BlockSource final
+{
+public:
+    static const size_t block_size = 64 * 1024;
+
+    explicit BlockSource(Input input, size_t blockSize = block_size)
+        : m_input(input), m_blockSize(blockSize)
+    {
+        m_buffer.resize(m_blockSize);
+    }
+    ~BlockSource()
+    {
+        if (m_end != m_begin) {
+            m_input.unread(m_end - m_begin);
+        }
+    }
+
+    inline bool eof() { return m_begin == m_end && !refill(m_blockSize); }
+    inline uint64_t position() const { return m_consumed; }
+
+    inline const uint8_t *require(size_t size)
+    {
+        if (m_end - m_begin < size) {
+            fill(size);
+        }
+
+        auto result = m_buffer.data() + m_begin;
+        m_begin += size;
+        m_consumed += size;
+        return result;
+    }
+
+    void skip(size_t size)
+    {
+        while (size > 0) {
+            if (m_begin == m_end && !refill(m_blockSize)) {
+                throwSourceEof();
+            }
+
+            auto step = std::min(size, m_end - m_begin);
+            m_begin += step;
+            m_consumed += step;
+            size -= step;
+        }
+    }
+
+private:
+    BlockSource(const BlockSource &) = delete;
+    void operator=(const BlockSource &) = delete;
+
+    /*!
+     * \brief Move unread bytes to the beginning and read at most `size` bytes after them.
+     * \return false if nothing was read
+     */
+    bool refill(size_t size)
+    {
+        if (m_begin != 0) {
+            memmove(m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin);
+            m_end -= m_begin;
+            m_begin = 0;
+        }
+        if (m_buffer.size() < m_end + size) {
+            m_buffer.resize(m_end + size);
+        }
+
+        auto count = m_input.read(m_buffer.data() + m_end, size);
+        m_end += count;
+
+        return count > 0;
+    }
+
+    /*!
+     * \brief Make `size` bytes available in memory
+     */
+    void fill(size_t size)
+    {
+        while (m_end - m_begin < size) {
+            // Buffer at most doubles per read, so it grows with data actually read and forged
+            // size can not allocate much more memory than the input contains.
+            auto available = m_end - m_begin;
+            if (!refill(std::max(m_blockSize, std::min(size - available, available)))) {
+                throwSourceEof();
+            }
+        }
+    }
+
+    Input m_input;
+    size_t m_blockSize{};
+    std::vector<uint8_t> m_buffer{};
+    size_t m_begin{};
+    size_t m_end{};
+    uint64_t m_consumed{};
+};
+
+typedef BlockSource<StreamInput> StreamSource;
+typedef BlockSource<FdInput> FdSource;
+
+/*!
+ * \brief Get UTF-16LE symbol from source
+ */
+template <typename Source>
+inline char16_t readSymbol(Source &source)
+{
+    uint16_t sym;
+
+    memcpy(&sym, source.require(sizeof(sym)), sizeof(sym));
+    return leToNative<uint16_t>(sym);
+}
+
+/*!
+ * \brief Get integral number from source (binary)
+ */
+template <typename T, bool LE = true, typename Source>
+inline T readIntegral(Source &source)
+{
+    T num;
+
+    memcpy(&num, source.require(sizeof(T)), sizeof(T));
+    if constexpr (LE) {
+        return leToNative<T>(num);
+    } else {
+        return beToNative<T>(num);
+    }
+}
+
+} // namespace pol
+
+#endif // PREGPARSER_SOURCE
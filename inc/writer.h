@@ -0,0 +1,98 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_WRITER
+#define PREGPARSER_WRITER
+
+#include <string_view>
+#include <vector>
+
+#include <iconv.h>
+
+#include <parser.h>
+#include <sink.h>
+
+namespace pol {
+
+/*!
+ * \brief Incremental writer of POL Registry file. Header is written on construction, every
+ * `add` encodes instruction straight into the sink, so file is never held in memory. Instantiated
+ * for the same sinks as `PRegParser::writeTo`.
+ * Keypath, value and type are validated before anything of instruction is written. Content of
+ * the sink is undefined after an error.
+ */
+template <typename Sink>
+class PRegWriter final
+{
+public:
+    explicit PRegWriter(Sink &sink);
+    ~PRegWriter();
+
+    void add(const PolicyInstruction &instruction);
+    void add(std::string_view keypath, std::string_view value, PolicyRegType type,
+             const PolicyData &data);
+    /*!
+     * \brief Add REG_SZ, REG_EXPAND_SZ or REG_LINK instruction from borrowed UTF-8 string
+     */
+    void addString(std::string_view keypath, std::string_view value, PolicyRegType type,
+                   std::string_view data);
+    /*!
+     * \brief Add REG_MULTI_SZ like instruction from borrowed UTF-8 strings
+     */
+    void addStrings(std::string_view keypath, std::string_view value, PolicyRegType type,
+                    const std::vector<std::string_view> &data);
+    /*!
+     * \brief Add REG_BINARY instruction from borrowed bytes
+     */
+    void addBinary(std::string_view keypath, std::string_view value, const uint8_t *data,
+                   size_t size);
+    /*!
+     * \brief Add DWORD or QWORD instruction (of both endianness)
+     */
+    void addInteger(std::string_view keypath, std::string_view value, PolicyRegType type,
+                    uint64_t data);
+    /*!
+     * \brief Flush the sink
+     */
+    void flush();
+    /*!
+     * \brief Count of written instructions
+     */
+    size_t count() const;
+
+private:
+    PRegWriter(const PRegWriter &) = delete;
+    void operator=(const PRegWriter &) = delete;
+
+    /*!
+     * \brief Validate and put instruction up to data (`LBracket KeyPath SC Value SC Type SC Size
+     * SC`)
+     */
+    void writePrefix(std::string_view keypath, std::string_view value, PolicyRegType type,
+                     size_t size);
+    void writeSuffix();
+
+    Sink &m_sink;
+    ::iconv_t m_iconvWriteId{};
+    size_t m_count{};
+};
+
+} // namespace pol
+
+#endif // PREGPARSER_WRITER
@@ -17,13 +17,38 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <algorithm>
 #include <iostream>
+#include <memory>
 
 #include <binary.h>
 #include <common.h>
 
 namespace pol {
 
+static const size_t read_block_size = 64 * 1024;
+
+/*!
+ * \brief Read `size` bytes from stream. Buffer grows with data actually read, so forged size can
+ * not allocate much more memory than the stream contains.
+ */
+static std::vector<uint8_t> readBytes(std::istream &buffer, size_t size)
+{
+    std::vector<uint8_t> result;
+
+    while (result.size() < size) {
+        auto offset = result.size();
+        auto step = std::min(size - offset, std::max(read_block_size, offset));
+
+        result.resize(offset + step);
+        buffer.read(reinterpret_cast<char *>(result.data() + offset),
+                    static_cast<std::streamsize>(step));
+        check_stream(buffer);
+    }
+
+    return result;
+}
+
 std::string readStringFromBuffer(std::istream &buffer, size_t size, iconv_t conv)
 {
     bool custom_conv = false;
@@ -38,21 +63,8 @@ std::string readStringFromBuffer(std::istream &buffer, size_t size, iconv_t conv
                 + ", Encountered with the inability to create a iconv descriptor.");
     }
 
-    std::basic_string<char16_t> source((size / 2) - 1, '\0');
-
-    // std::the string contains '\0' at the end (C style), which means that the actual buffer size
-    // is `size`. We read `size` bytes to check that the buffer ends with '\0'.
-    // '\0' is included in `size`, so we read `size` bytes.
-    buffer.read(reinterpret_cast<char *>(source.data()), size);
-    check_stream(buffer);
-
-    // Check that the buffer ends with the two '\0'.
-    if (source.data()[(size / 2) - 1] != 0) {
-        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
-                                 + ", Encountered with invalid UTF-16LE buffer.");
-    }
-
-    auto result = convert<char, char16_t>(source, conv);
+    auto source = readBytes(buffer, size);
+    auto result = readStringFromMemory(source.data(), source.size(), conv);
     if (custom_conv) {
         iconv_close(conv);
     }
@@ -73,16 +85,14 @@ size_t writeStringToBuffer(std::ostream &buffer, const std::string &source, icon
                 + ", Encountered with the inability to create a iconv descriptor.");
     }
 
-    std::basic_string<char16_t> converted = convert<char16_t, char>(source, conv);
-
-    buffer.write(reinterpret_cast<char *>(converted.data()),
-                 (converted.size() + 1) * sizeof(char16_t));
-    check_stream(buffer);
+    // Single string is not worth a block, chunks go to the stream unbuffered.
+    StreamOutput sink(buffer);
+    auto written = writeStringToSink(sink, source, conv);
 
     if (custom_conv) {
         iconv_close(conv);
     }
-    return (converted.size() + 1) * sizeof(char16_t);
+    return written;
 }
 
 std::vector<std::string> readStringsFromBuffer(std::istream &buffer, size_t size, iconv_t conv)
@@ -103,39 +113,109 @@ std::vector<std::string> readStringsFromBuffer(std::istream &buffer, size_t size
                 + ", Encountered with the inability to create a iconv descriptor.");
     }
 
-    std::vector<std::string> result;
-    std::basic_string<char16_t> tmp;
-    size_t current = 0;
-    size_t found = 0;
-
-    // std::string contains '\0' at the end (C style), which means that the actual buffer size
-    // is `size`. We read `size` bytes to check that the buffer ends with '\0'.
-    // '\0' is included in `size`, so we read `size` bytes.
-    tmp.resize((size / 2) - 1);
-    buffer.read(reinterpret_cast<char *>(tmp.data()), size);
-    check_stream(buffer);
+    auto source = readBytes(buffer, size);
+    auto result = readStringsFromMemory(source.data(), source.size(), conv);
 
-    while (found <= tmp.size()) {
-        found = tmp.find(char16_t(0), current);
+    if (custom_conv) {
+        iconv_close(conv);
+    }
+    return result;
+}
 
-        if (found == std::string::npos) {
-            found = tmp.size();
+/*!
+ * \brief Check that UTF-16LE buffer of `size` bytes is not empty and ends with '\0'
+ */
+static inline void checkStringMemory(const uint8_t *data, size_t size)
+{
+    if (size < sizeof(char16_t) || size % sizeof(char16_t) != 0 || data[size - 1] != 0
+        || data[size - 2] != 0) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Encountered with invalid UTF-16LE buffer.");
+    }
+}
 
-            if (tmp.data()[found] != 0) {
-                return {};
-            }
+std::string readStringFromMemory(const uint8_t *data, size_t size, iconv_t conv)
+{
+    std::string result;
+
+    checkStringMemory(data, size);
+
+    auto begin = reinterpret_cast<const char16_t *>(data);
+    convertChunked<char, char16_t>(begin, begin + (size / 2) - 1, conv,
+                                   [&result](const char *chunkBegin, const char *chunkEnd) {
+                                       result.append(chunkBegin, chunkEnd);
+                                   });
+
+    return result;
+}
+
+/*!
+ * \brief Number of bytes required to store `units` of UTF-16LE as UTF-8. Unpaired surrogates
+ * are counted as 3 bytes, iconv rejects them anyway.
+ */
+static size_t utf8Length(const uint8_t *data, size_t units)
+{
+    size_t length = 0;
+
+    for (size_t i = 0; i < units; ++i) {
+        uint16_t unit = static_cast<uint16_t>(data[i * 2] | (data[i * 2 + 1] << 8));
+        if (unit < 0x80) {
+            length += 1;
+        } else if (unit < 0x800) {
+            length += 2;
+        } else {
+            // Surrogate pair takes 4 bytes, 2 per unit.
+            length += unit >= 0xD800 && unit <= 0xDFFF ? 2 : 3;
         }
+    }
 
-        result.push_back(
-                convert<char, char16_t>(tmp.cbegin() + current, tmp.cbegin() + found, conv));
+    return length;
+}
+
+std::vector<std::string> readStringsFromMemory(const uint8_t *data, size_t size, iconv_t conv)
+{
+    std::vector<std::string> result;
 
-        current = found + 1;
-        found = current;
+    if (size == 0) {
+        return {};
+    }
+    // Like `readStringsFromBuffer`, data without final '\0' is treated as empty list.
+    if (size < sizeof(char16_t) || size % sizeof(char16_t) != 0 || data[size - 1] != 0
+        || data[size - 2] != 0) {
+        return {};
     }
 
-    if (custom_conv) {
-        iconv_close(conv);
+    // Whole block is transcoded by single iconv call, separators stay '\0' in UTF-8. Output
+    // buffer is sized by quick pass over input, so it takes no more than decoded strings and
+    // is never full: when output is full, iconv of glibc converts again the part of input which
+    // did not fit.
+    size_t units = size / sizeof(char16_t) - 1;
+    size_t length = utf8Length(data, units);
+    std::unique_ptr<char[]> converted(new char[std::max<size_t>(length, 1)]);
+    auto inbuf = reinterpret_cast<char *>(const_cast<uint8_t *>(data));
+    size_t inbytesLeft = units * sizeof(char16_t);
+    auto outbuf = converted.get();
+    size_t outbytesLeft = length;
+
+    if (units != 0
+        && iconv(conv, &inbuf, &inbytesLeft, &outbuf, &outbytesLeft) == ICONV_ERROR_CODE) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Encountered corrupted unicode string.");
+    }
+
+    // Every '\0' (except final) splits strings, so the last string is always present.
+    std::string_view rest(converted.get(), outbuf - converted.get());
+    result.reserve(std::count(rest.begin(), rest.end(), '\0') + 1);
+    while (true) {
+        auto found = rest.find('\0');
+        result.emplace_back(rest.substr(0, found));
+
+        if (found == std::string_view::npos) {
+            break;
+        }
+        rest.remove_prefix(found + 1);
     }
+
     return result;
 }
 
@@ -153,13 +233,16 @@ size_t writeStringsFromBuffer(std::ostream &buffer, const std::vector<std::strin
 
 std::vector<uint8_t> readVectorFromBuffer(std::istream &buffer, size_t size)
 {
-    std::vector<uint8_t> result;
-    result.resize(size);
-
-    buffer.read(reinterpret_cast<char *>(result.data()), size);
-    check_stream(buffer);
+    return readBytes(buffer, size);
+}
 
-    return result;
+void skipBuffer(std::istream &buffer, size_t size)
+{
+    buffer.ignore(static_cast<std::streamsize>(size));
+    if (static_cast<size_t>(buffer.gcount()) != size) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Failed to skip buffer, EOF was encountered.");
+    }
 }
 
 void writeVectorToBuffer(std::ostream &buffer, const std::vector<uint8_t> &data)
@@ -0,0 +1,225 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+
+#include <canonical.h>
+#include <casefold.h>
+
+namespace pol {
+
+/*!
+ * \brief Ranges shorter than this are sorted by insertion
+ */
+static const ptrdiff_t insertion_sort_size = 16;
+
+/*!
+ * \brief Lowercase `keypath '\0' value` of instruction. Names do not contain '\0', so keypath
+ * ends before any of its continuations.
+ */
+typedef struct SortKey
+{
+    const char *data{};
+    size_t size{};
+    size_t index{};
+} SortKey;
+
+/*!
+ * \brief Symbol of key at `depth`, -1 past the end
+ */
+static inline int getSymbol(const SortKey &key, size_t depth)
+{
+    return depth < key.size ? static_cast<unsigned char>(key.data[depth]) : -1;
+}
+
+static inline bool keyLess(const SortKey &lhs, const SortKey &rhs, size_t depth)
+{
+    for (;; ++depth) {
+        int left = getSymbol(lhs, depth);
+        int right = getSymbol(rhs, depth);
+
+        if (left != right || left == -1) {
+            return left < right;
+        }
+    }
+}
+
+static void insertionSort(SortKey *begin, SortKey *end, size_t depth)
+{
+    for (auto current = begin + 1; current < end; ++current) {
+        auto key = *current;
+        auto position = current;
+
+        for (; position > begin && keyLess(key, position[-1], depth); --position) {
+            *position = position[-1];
+        }
+        *position = key;
+    }
+}
+
+static inline int medianSymbol(const SortKey *begin, const SortKey *end, size_t depth)
+{
+    int first = getSymbol(*begin, depth);
+    int middle = getSymbol(begin[(end - begin) / 2], depth);
+    int last = getSymbol(end[-1], depth);
+
+    return std::max(std::min(first, middle), std::min(std::max(first, middle), last));
+}
+
+/*!
+ * \brief Length of prefix shared by all keys of range, starting at `depth`. Every key is read
+ * once for the whole prefix instead of once per symbol.
+ */
+static size_t commonPrefix(const SortKey *begin, const SortKey *end, size_t depth)
+{
+    size_t common = begin->size - std::min(begin->size, depth);
+
+    for (auto current = begin + 1; current < end && common > 0; ++current) {
+        auto first = begin->data + depth;
+        auto size = std::min(common, current->size - std::min(current->size, depth));
+        common = std::mismatch(first, first + size, current->data + depth).first - first;
+    }
+
+    return common;
+}
+
+/*!
+ * \brief Range of keys equal up to `depth`
+ */
+typedef struct SortRange
+{
+    SortKey *begin{};
+    SortKey *end{};
+    size_t depth{};
+} SortRange;
+
+/*!
+ * \brief Multikey quicksort (Bentley, Sedgewick): three-way partition by symbol at `depth`,
+ * equal part advances to the next symbol. Two smaller parts are sorted recursively and the
+ * largest one in loop, so every recursive call takes at most half of range and recursion depth
+ * is logarithmic. Loop skips prefix shared by all keys of range.
+ */
+static void multikeySort(SortKey *begin, SortKey *end, size_t depth)
+{
+    while (end - begin > insertion_sort_size) {
+        depth += commonPrefix(begin, end, depth);
+
+        int pivot = medianSymbol(begin, end, depth);
+        auto less = begin;
+        auto greater = end;
+
+        for (auto current = begin; current < greater;) {
+            int symbol = getSymbol(*current, depth);
+            if (symbol < pivot) {
+                std::swap(*less++, *current++);
+            } else if (symbol > pivot) {
+                std::swap(*current, *--greater);
+            } else {
+                ++current;
+            }
+        }
+
+        // Keys of equal part have ended if pivot is -1, they are equal then.
+        SortRange parts[] = { { begin, less, depth },
+                              { greater, end, depth },
+                              { less, pivot == -1 ? less : greater, depth + 1 } };
+        auto largest = std::max_element(parts, parts + 3, [](const auto &lhs, const auto &rhs) {
+            return lhs.end - lhs.begin < rhs.end - rhs.begin;
+        });
+
+        for (const auto &part : parts) {
+            if (&part != largest) {
+                multikeySort(part.begin, part.end, part.depth);
+            }
+        }
+        begin = largest->begin;
+        end = largest->end;
+        depth = largest->depth;
+    }
+
+    insertionSort(begin, end, depth);
+}
+
+static inline bool keyEqual(const SortKey &lhs, const SortKey &rhs)
+{
+    return lhs.size == rhs.size && std::equal(lhs.data, lhs.data + lhs.size, rhs.data);
+}
+
+std::vector<size_t> canonicalOrder(const PolicyTree &instructions)
+{
+    std::string pool;
+    std::vector<SortKey> keys(instructions.size());
+    size_t size = 0;
+
+    // Keys are put into one pool, so there is single allocation for all of them.
+    for (const auto &instruction : instructions) {
+        size += instruction.key.size() + instruction.value.size() + 1;
+    }
+    pool.reserve(size);
+    for (size_t i = 0; i < instructions.size(); ++i) {
+        keys[i].size = instructions[i].key.size() + instructions[i].value.size() + 1;
+        keys[i].index = i;
+        for (auto sym : instructions[i].key) {
+            pool.push_back(foldCase(sym));
+        }
+        pool.push_back('\0');
+        for (auto sym : instructions[i].value) {
+            pool.push_back(foldCase(sym));
+        }
+    }
+
+    const char *data = pool.data();
+    for (auto &key : keys) {
+        key.data = data;
+        data += key.size;
+    }
+
+    multikeySort(keys.data(), keys.data() + keys.size(), 0);
+
+    // Equal keys are adjacent, the last instruction of them wins.
+    std::vector<size_t> result;
+    result.reserve(keys.size());
+    for (size_t i = 0; i < keys.size();) {
+        size_t last = keys[i].index;
+        size_t next = i + 1;
+
+        for (; next < keys.size() && keyEqual(keys[i], keys[next]); ++next) {
+            last = std::max(last, keys[next].index);
+        }
+        result.push_back(last);
+        i = next;
+    }
+
+    return result;
+}
+
+void canonicalize(PolicyFile &file)
+{
+    auto order = canonicalOrder(file.instructions);
+    PolicyTree instructions;
+
+    instructions.reserve(order.size());
+    for (auto index : order) {
+        instructions.push_back(std::move(file.instructions[index]));
+    }
+    file.instructions = std::move(instructions);
+    file.parsedFingerprint.reset();
+}
+
+} // namespace pol
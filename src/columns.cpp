@@ -0,0 +1,156 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <limits>
+
+#include <columns.h>
+
+namespace pol {
+
+PolicyColumns PolicyColumns::fromFile(const PolicyFile &file)
+{
+    return makeLayout<PolicyColumns>(file);
+}
+
+PolicyFile PolicyColumns::toFile() const
+{
+    return makeFile(*this);
+}
+
+void PolicyColumns::add(const PolicyInstruction &instruction)
+{
+    // Everything that can throw goes before any column is extended, columns stay of equal size.
+    auto keypath = intern(instruction.key);
+    auto value = intern(instruction.value);
+    auto offset = m_blobs.size();
+
+    encodeData(instruction.data, m_blobs);
+    if (m_blobs.size() - offset > std::numeric_limits<uint32_t>::max()) {
+        m_blobs.resize(offset);
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Data of instruction is too large.");
+    }
+
+    m_keypaths.push_back(keypath);
+    m_values.push_back(value);
+    m_types.push_back(instruction.type);
+    m_dataOffsets.push_back(offset);
+    m_dataSizes.push_back(static_cast<uint32_t>(m_blobs.size() - offset));
+    m_alternatives.push_back(static_cast<PolicyDataAlternative>(instruction.data.index()));
+}
+
+void PolicyColumns::reserve(size_t count)
+{
+    m_keypaths.reserve(count);
+    m_values.reserve(count);
+    m_types.reserve(count);
+    m_dataOffsets.reserve(count);
+    m_dataSizes.reserve(count);
+    m_alternatives.reserve(count);
+}
+
+size_t PolicyColumns::size() const
+{
+    return m_keypaths.size();
+}
+
+const std::vector<uint32_t> &PolicyColumns::keypaths() const
+{
+    return m_keypaths;
+}
+
+const std::vector<uint32_t> &PolicyColumns::values() const
+{
+    return m_values;
+}
+
+const std::vector<PolicyRegType> &PolicyColumns::types() const
+{
+    return m_types;
+}
+
+const std::vector<uint64_t> &PolicyColumns::dataOffsets() const
+{
+    return m_dataOffsets;
+}
+
+const std::vector<uint32_t> &PolicyColumns::dataSizes() const
+{
+    return m_dataSizes;
+}
+
+size_t PolicyColumns::stringCount() const
+{
+    return m_stringOffsets.size() - 1;
+}
+
+std::string_view PolicyColumns::string(uint32_t id) const
+{
+    return { m_strings.data() + m_stringOffsets[id],
+             static_cast<size_t>(m_stringOffsets[id + 1] - m_stringOffsets[id]) };
+}
+
+std::optional<uint32_t> PolicyColumns::findString(std::string_view string) const
+{
+    auto found = findInterned(m_stringIds, hashString(string), string,
+                              [this](uint32_t id) { return this->string(id); });
+
+    return found ? std::optional<uint32_t>(*found) : std::nullopt;
+}
+
+std::string_view PolicyColumns::blob(size_t index) const
+{
+    return { m_blobs.data() + m_dataOffsets[index], m_dataSizes[index] };
+}
+
+uint64_t PolicyColumns::integer(size_t index) const
+{
+    return decodeInteger(m_alternatives[index], blob(index));
+}
+
+PolicyData PolicyColumns::data(size_t index) const
+{
+    return decodeData(m_alternatives[index], blob(index));
+}
+
+PolicyInstruction PolicyColumns::instruction(size_t index) const
+{
+    PolicyInstruction result;
+
+    result.key = std::string(string(m_keypaths[index]));
+    result.value = std::string(string(m_values[index]));
+    result.type = m_types[index];
+    result.data = data(index);
+
+    return result;
+}
+
+uint32_t PolicyColumns::intern(std::string_view string)
+{
+    return pol::intern(
+            m_stringIds, string, [this](uint32_t id) { return this->string(id); },
+            [this](std::string_view bytes) {
+                auto id = static_cast<uint32_t>(stringCount());
+                m_strings.append(bytes);
+                m_stringOffsets.push_back(m_strings.size());
+                return id;
+            });
+}
+
+} // namespace pol
@@ -0,0 +1,207 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+
+#include <compact.h>
+#include <layout.h>
+
+namespace pol {
+
+enum CompactStorage : uint8_t {
+    Inline = 0,
+    Pooled = 1,
+};
+
+static const uint8_t storage_mask = 0x03;
+
+static inline PolicyDataAlternative getAlternative(const PolicyCompactData &data)
+{
+    return static_cast<PolicyDataAlternative>(data.tag >> 2);
+}
+
+PolicyCompactFile PolicyCompactFile::fromFile(const PolicyFile &file)
+{
+    return makeLayout<PolicyCompactFile>(file);
+}
+
+PolicyCompactFile PolicyCompactFile::parse(PRegParser &parser, const uint8_t *data, size_t size)
+{
+    auto bounds = scanInstructions(data, size);
+    ParseUsage usage;
+    PolicyCompactFile result;
+
+    for (const auto &instructionBounds : bounds) {
+        checkLimits(parser.getLimits(), usage, data, instructionBounds);
+    }
+
+    result.reserve(bounds.size());
+    for (const auto &instructionBounds : bounds) {
+        result.add(parser.materialize(data, instructionBounds));
+    }
+
+    return result;
+}
+
+PolicyFile PolicyCompactFile::toFile() const
+{
+    return makeFile(*this);
+}
+
+void PolicyCompactFile::add(const PolicyInstruction &instruction)
+{
+    PolicyCompactInstruction result;
+
+    result.key = storeKeypath(instruction.key);
+    result.value = store(instruction.value, PolicyDataAlternative::String);
+    result.type = static_cast<uint8_t>(instruction.type);
+
+    // Data is encoded right into pool, short data is moved inline.
+    auto offset = m_pool.size();
+    encodeData(instruction.data, m_pool);
+    result.data = store(offset, static_cast<PolicyDataAlternative>(instruction.data.index()));
+
+    m_instructions.push_back(result);
+}
+
+void PolicyCompactFile::reserve(size_t count)
+{
+    m_instructions.reserve(count);
+}
+
+size_t PolicyCompactFile::size() const
+{
+    return m_instructions.size();
+}
+
+std::string_view PolicyCompactFile::key(size_t index) const
+{
+    return getBytes(m_instructions[index].key);
+}
+
+std::string_view PolicyCompactFile::value(size_t index) const
+{
+    return getBytes(m_instructions[index].value);
+}
+
+PolicyRegType PolicyCompactFile::type(size_t index) const
+{
+    return static_cast<PolicyRegType>(m_instructions[index].type);
+}
+
+std::string_view PolicyCompactFile::bytes(size_t index) const
+{
+    return getBytes(m_instructions[index].data);
+}
+
+uint64_t PolicyCompactFile::integer(size_t index) const
+{
+    const auto &data = m_instructions[index].data;
+    return decodeInteger(getAlternative(data), getBytes(data));
+}
+
+PolicyData PolicyCompactFile::data(size_t index) const
+{
+    const auto &data = m_instructions[index].data;
+    return decodeData(getAlternative(data), getBytes(data));
+}
+
+PolicyInstruction PolicyCompactFile::instruction(size_t index) const
+{
+    PolicyInstruction result;
+
+    result.key = std::string(key(index));
+    result.value = std::string(value(index));
+    result.type = type(index);
+    result.data = data(index);
+
+    return result;
+}
+
+size_t PolicyCompactFile::memoryUsage() const
+{
+    size_t usage = m_instructions.capacity() * sizeof(PolicyCompactInstruction)
+            + m_pool.capacity();
+
+    // Node of hash table holds entry and pointer to next node, table holds buckets.
+    return usage + m_keypaths.size() * (sizeof(*m_keypaths.begin()) + sizeof(void *))
+            + m_keypaths.bucket_count() * sizeof(void *);
+}
+
+PolicyCompactData PolicyCompactFile::store(std::string_view bytes,
+                                           PolicyDataAlternative alternative)
+{
+    auto offset = m_pool.size();
+
+    m_pool.append(bytes);
+    return store(offset, alternative);
+}
+
+PolicyCompactData PolicyCompactFile::store(size_t offset, PolicyDataAlternative alternative)
+{
+    PolicyCompactData result;
+    auto size = m_pool.size() - offset;
+    auto tag = static_cast<uint8_t>(alternative) << 2;
+
+    if (size <= sizeof(result.payload)) {
+        memcpy(result.payload, m_pool.data() + offset, size);
+        m_pool.resize(offset);
+        result.size = static_cast<uint8_t>(size);
+        result.tag = static_cast<uint8_t>(CompactStorage::Inline | tag);
+        return result;
+    }
+
+    uint64_t position = offset;
+    auto pooledSize = static_cast<uint32_t>(size);
+
+    memcpy(result.payload, &position, sizeof(position));
+    memcpy(result.payload + sizeof(position), &pooledSize, sizeof(pooledSize));
+    result.tag = static_cast<uint8_t>(CompactStorage::Pooled | tag);
+
+    return result;
+}
+
+PolicyCompactData PolicyCompactFile::storeKeypath(std::string_view keypath)
+{
+    if (keypath.size() <= sizeof(PolicyCompactData::payload)) {
+        return store(keypath, PolicyDataAlternative::String);
+    }
+
+    // Files repeat few keypaths many times, each is put into pool once.
+    return intern(
+            m_keypaths, keypath, [this](const PolicyCompactData &data) { return getBytes(data); },
+            [this](std::string_view bytes) {
+                return store(bytes, PolicyDataAlternative::String);
+            });
+}
+
+std::string_view PolicyCompactFile::getBytes(const PolicyCompactData &data) const
+{
+    if ((data.tag & storage_mask) == CompactStorage::Inline) {
+        return { reinterpret_cast<const char *>(data.payload), data.size };
+    }
+
+    uint64_t offset;
+    uint32_t size;
+    memcpy(&offset, data.payload, sizeof(offset));
+    memcpy(&size, data.payload + sizeof(offset), sizeof(size));
+    return { m_pool.data() + offset, size };
+}
+
+} // namespace pol
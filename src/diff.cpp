@@ -0,0 +1,182 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+
+#include <casefold.h>
+#include <diff.h>
+
+namespace pol {
+
+typedef std::pair<std::string_view, std::string_view> EntryId;
+
+static inline EntryId entryId(const PolicyInstruction &instruction)
+{
+    return { instruction.key, instruction.value };
+}
+
+static inline int compareEntries(const EntryId &lhs, const EntryId &rhs)
+{
+    int result = compareFolded(lhs.first, rhs.first);
+    return result != 0 ? result : compareFolded(lhs.second, rhs.second);
+}
+
+/*!
+ * \brief Order of `canonicalOrder`, so canonical files take the sorted path
+ */
+static inline bool entryLess(const PolicyInstruction &lhs, const PolicyInstruction &rhs)
+{
+    return compareEntries(entryId(lhs), entryId(rhs)) < 0;
+}
+
+/*!
+ * \brief Hash and equality of entries ignoring ASCII case
+ */
+struct EntryHash
+{
+    size_t operator()(const EntryId &entry) const
+    {
+        return static_cast<size_t>(hashFolded(entry.second, hashFolded(entry.first)));
+    }
+};
+
+struct EntryEqual
+{
+    bool operator()(const EntryId &lhs, const EntryId &rhs) const
+    {
+        return equalFolded(lhs.first, rhs.first) && equalFolded(lhs.second, rhs.second);
+    }
+};
+
+static inline bool sameContent(const PolicyInstruction &lhs, const PolicyInstruction &rhs)
+{
+    return lhs.type == rhs.type && lhs.data == rhs.data;
+}
+
+/*!
+ * \brief Index of effective instructions: (keypath, value) -> position of the last occurrence
+ */
+static std::unordered_map<EntryId, size_t, EntryHash, EntryEqual>
+buildIndex(const PolicyTree &tree)
+{
+    std::unordered_map<EntryId, size_t, EntryHash, EntryEqual> index;
+
+    index.reserve(tree.size());
+    for (size_t i = 0; i < tree.size(); ++i) {
+        index[entryId(tree[i])] = i;
+    }
+
+    return index;
+}
+
+static PolicyDiff diffHashed(const PolicyTree &a, const PolicyTree &b)
+{
+    PolicyDiff result;
+    auto indexA = buildIndex(a);
+    auto indexB = buildIndex(b);
+    std::vector<bool> matched(a.size(), false);
+
+    for (size_t i = 0; i < b.size(); ++i) {
+        auto id = entryId(b[i]);
+
+        // Overridden by later instruction with the same identity.
+        if (indexB[id] != i) {
+            continue;
+        }
+
+        auto found = indexA.find(id);
+        if (found == indexA.end()) {
+            result.added.push_back(b[i]);
+            continue;
+        }
+
+        matched[found->second] = true;
+        if (!sameContent(a[found->second], b[i])) {
+            result.changed.push_back({ a[found->second], b[i] });
+        }
+    }
+
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (!matched[i] && indexA[entryId(a[i])] == i) {
+            result.removed.push_back(a[i]);
+        }
+    }
+
+    return result;
+}
+
+/*!
+ * \brief Skip run of equal entries, return position of the last one in run
+ */
+static inline size_t lastOfRun(const PolicyTree &tree, size_t position)
+{
+    while (position + 1 < tree.size()
+           && compareEntries(entryId(tree[position + 1]), entryId(tree[position])) == 0) {
+        ++position;
+    }
+    return position;
+}
+
+static PolicyDiff diffSorted(const PolicyTree &a, const PolicyTree &b)
+{
+    PolicyDiff result;
+    size_t i = 0;
+    size_t j = 0;
+
+    while (i < a.size() && j < b.size()) {
+        i = lastOfRun(a, i);
+        j = lastOfRun(b, j);
+
+        if (entryLess(a[i], b[j])) {
+            result.removed.push_back(a[i++]);
+        } else if (entryLess(b[j], a[i])) {
+            result.added.push_back(b[j++]);
+        } else {
+            if (!sameContent(a[i], b[j])) {
+                result.changed.push_back({ a[i], b[j] });
+            }
+            ++i;
+            ++j;
+        }
+    }
+    for (; i < a.size(); ++i) {
+        i = lastOfRun(a, i);
+        result.removed.push_back(a[i]);
+    }
+    for (; j < b.size(); ++j) {
+        j = lastOfRun(b, j);
+        result.added.push_back(b[j]);
+    }
+
+    return result;
+}
+
+PolicyDiff diff(const PolicyFile &a, const PolicyFile &b)
+{
+    if (std::is_sorted(a.instructions.begin(), a.instructions.end(), entryLess)
+        && std::is_sorted(b.instructions.begin(), b.instructions.end(), entryLess)) {
+        return diffSorted(a.instructions, b.instructions);
+    }
+
+    return diffHashed(a.instructions, b.instructions);
+}
+
+} // namespace pol
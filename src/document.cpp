@@ -0,0 +1,326 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstring>
+
+#include <casefold.h>
+#include <document.h>
+#include <hash.h>
+#include <writer.h>
+
+namespace pol {
+
+static const uint8_t document_header[] = { 0x50, 0x52, 0x65, 0x67, 0x01, 0x00, 0x00, 0x00 };
+static const size_t npos = static_cast<size_t>(-1);
+
+/*!
+ * \brief Instruction is encoded by `writer` into `pool` (after header, which is never saved),
+ * then copied into buffer owned by its slot. Kept behind pointer, so document stays movable.
+ */
+struct PolicyDocument::Editor
+{
+    std::vector<uint8_t> pool{};
+    VectorSink sink{ pool };
+    PRegWriter<VectorSink> writer{ sink };
+    std::unique_ptr<PRegParser> parser{ createPregParser() };
+};
+
+/*!
+ * \brief Index key: encoded instruction from keypath to the end of value, i.e. UTF-16LE keypath,
+ * `\0;` and value. It is taken straight from buffer without decoding or copying.
+ */
+static std::string_view makeKey(const uint8_t *data, const PolicyInstructionBounds &bounds)
+{
+    return { reinterpret_cast<const char *>(data + bounds.offset + 2),
+             bounds.valueOffset + bounds.valueSize - bounds.offset - 2 };
+}
+
+/*!
+ * \brief Index key of names, see above. Names consist of ASCII symbols.
+ */
+static std::string makeKey(std::string_view keypath, std::string_view value)
+{
+    std::string key;
+
+    key.reserve((keypath.size() + value.size() + 2) * 2);
+    for (auto sym : keypath) {
+        key.push_back(sym);
+        key.push_back('\0');
+    }
+    key.append("\0\0;", 4);
+    for (auto sym : value) {
+        key.push_back(sym);
+        key.push_back('\0');
+    }
+
+    return key;
+}
+
+size_t PolicyDocument::KeyHash::operator()(std::string_view key) const
+{
+    return static_cast<size_t>(hashFolded(key));
+}
+
+bool PolicyDocument::KeyEqual::operator()(std::string_view lhs, std::string_view rhs) const
+{
+    return equalFolded(lhs, rhs);
+}
+
+static inline size_t getSpanSize(const PolicyInstructionBounds &bounds)
+{
+    return bounds.dataOffset + bounds.size + 2 - bounds.offset;
+}
+
+PolicyDocument::PolicyDocument() : m_editor(std::make_unique<Editor>()) { }
+
+PolicyDocument::PolicyDocument(std::vector<uint8_t> buffer)
+    : m_editor(std::make_unique<Editor>())
+{
+    auto owner = std::make_shared<std::vector<uint8_t>>(std::move(buffer));
+
+    m_data = owner->data();
+    m_size = owner->size();
+    m_owner = std::move(owner);
+    open();
+}
+
+PolicyDocument::PolicyDocument(std::shared_ptr<const void> owner, const uint8_t *data,
+                               size_t size)
+    : m_owner(std::move(owner)), m_data(data), m_size(size), m_editor(std::make_unique<Editor>())
+{
+    open();
+}
+
+PolicyDocument PolicyDocument::map(const std::string &path)
+{
+    auto source = std::make_shared<MmapSource>(path);
+    auto data = source->data();
+    auto size = source->size();
+
+    return PolicyDocument(std::move(source), data, size);
+}
+
+PolicyDocument::PolicyDocument(PolicyDocument &&) = default;
+PolicyDocument &PolicyDocument::operator=(PolicyDocument &&) = default;
+PolicyDocument::~PolicyDocument() = default;
+
+void PolicyDocument::open()
+{
+    auto bounds = scanInstructions(m_data, m_size);
+
+    m_slots.reserve(bounds.size());
+    m_index.reserve(bounds.size());
+    for (const auto &instructionBounds : bounds) {
+        auto &last = m_index.try_emplace(makeKey(m_data, instructionBounds), npos).first->second;
+
+        m_slots.push_back({ m_data, instructionBounds, last, false });
+        last = m_slots.size() - 1;
+    }
+}
+
+void PolicyDocument::eraseChain(size_t slot)
+{
+    while (slot != npos) {
+        m_slots[slot].erased = true;
+        m_slots[slot].edit = std::vector<uint8_t>();
+        ++m_erased;
+        slot = m_slots[slot].previous;
+    }
+}
+
+void PolicyDocument::compact()
+{
+    // Tombstones are dropped once they are the most of slots, so repeated erase and insert of
+    // the same key keeps memory bounded. Slot buffers do not move, index keys stay valid.
+    if (m_erased <= m_slots.size() / 2) {
+        return;
+    }
+
+    std::vector<size_t> positions(m_slots.size(), npos);
+    size_t count = 0;
+    for (size_t i = 0; i < m_slots.size(); ++i) {
+        if (m_slots[i].erased) {
+            continue;
+        }
+        // Earlier instructions of live key are live too, they are already moved.
+        if (m_slots[i].previous != npos) {
+            m_slots[i].previous = positions[m_slots[i].previous];
+        }
+        positions[i] = count;
+        if (count != i) {
+            m_slots[count] = std::move(m_slots[i]);
+        }
+        ++count;
+    }
+    m_slots.resize(count);
+
+    for (auto &entry : m_index) {
+        entry.second = positions[entry.second];
+    }
+    m_erased = 0;
+}
+
+size_t PolicyDocument::size() const
+{
+    return m_index.size();
+}
+
+bool PolicyDocument::contains(std::string_view keypath, std::string_view value) const
+{
+    return m_index.find(makeKey(keypath, value)) != m_index.end();
+}
+
+std::optional<PolicyInstruction> PolicyDocument::find(std::string_view keypath,
+                                                      std::string_view value) const
+{
+    auto found = m_index.find(makeKey(keypath, value));
+    if (found == m_index.end()) {
+        return std::nullopt;
+    }
+
+    const auto &slot = m_slots[found->second];
+    return m_editor->parser->materialize(slot.base, slot.bounds);
+}
+
+void PolicyDocument::set(const PolicyInstruction &instruction)
+{
+    auto &pool = m_editor->pool;
+    std::vector<uint8_t> edit;
+    PolicyInstructionBounds bounds;
+
+    // Writer validates names and data before writing, the rest can fail only on encoding.
+    try {
+        m_editor->writer.add(instruction);
+        edit.assign(pool.begin() + sizeof(document_header), pool.end());
+        pool.resize(sizeof(document_header));
+    } catch (...) {
+        pool.resize(sizeof(document_header));
+        throw;
+    }
+
+    const auto *base = edit.data();
+    scanInstruction(base, edit.size(), 0, bounds);
+
+    auto key = makeKey(base, bounds);
+    auto found = m_index.find(key);
+
+    if (found == m_index.end()) {
+        m_slots.push_back({ base, bounds, npos, false, std::move(edit) });
+        m_index.emplace(key, m_slots.size() - 1);
+        return;
+    }
+
+    // Instruction is replaced in place, its earlier duplicates are removed. Key is moved to the
+    // new bytes first, so bytes of replaced instruction are released.
+    auto position = found->second;
+    auto entry = m_index.extract(found);
+    entry.key() = key;
+    m_index.insert(std::move(entry));
+
+    eraseChain(m_slots[position].previous);
+    m_slots[position] = { base, bounds, npos, false, std::move(edit) };
+    compact();
+}
+
+bool PolicyDocument::insert(const PolicyInstruction &instruction)
+{
+    if (contains(instruction.key, instruction.value)) {
+        return false;
+    }
+    set(instruction);
+
+    return true;
+}
+
+bool PolicyDocument::erase(std::string_view keypath, std::string_view value)
+{
+    auto found = m_index.find(makeKey(keypath, value));
+    if (found == m_index.end()) {
+        return false;
+    }
+
+    // Key may refer to bytes of erased instruction, so it is removed first.
+    auto slot = found->second;
+    m_index.erase(found);
+    eraseChain(slot);
+    compact();
+
+    return true;
+}
+
+std::vector<PolicySpan> PolicyDocument::spans() const
+{
+    std::vector<PolicySpan> result;
+
+    result.push_back({ m_size ? m_data : document_header, sizeof(document_header) });
+    for (const auto &slot : m_slots) {
+        if (slot.erased) {
+            continue;
+        }
+
+        auto data = slot.base + slot.bounds.offset;
+        auto size = getSpanSize(slot.bounds);
+        auto &last = result.back();
+
+        if (last.data + last.size == data) {
+            last.size += size;
+        } else {
+            result.push_back({ data, size });
+        }
+    }
+
+    return result;
+}
+
+template <typename Sink>
+void PolicyDocument::save(Sink &sink) const
+{
+    for (const auto &span : spans()) {
+        sink.write(span.data, span.size);
+    }
+    sink.flush();
+}
+
+std::vector<uint8_t> PolicyDocument::save() const
+{
+    auto gathered = spans();
+    size_t size = 0;
+
+    for (const auto &span : gathered) {
+        size += span.size;
+    }
+
+    std::vector<uint8_t> result;
+    result.reserve(size);
+    for (const auto &span : gathered) {
+        result.insert(result.end(), span.data, span.data + span.size);
+    }
+
+    return result;
+}
+
+template void PolicyDocument::save(BufferSink &sink) const;
+template void PolicyDocument::save(VectorSink &sink) const;
+template void PolicyDocument::save(StreamSink &sink) const;
+template void PolicyDocument::save(FdSink &sink) const;
+template void PolicyDocument::save(StreamOutput &sink) const;
+template void PolicyDocument::save(FdOutput &sink) const;
+
+} // namespace pol
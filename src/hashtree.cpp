@@ -0,0 +1,255 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <casefold.h>
+#include <common.h>
+#include <hash.h>
+#include <hashtree.h>
+
+namespace pol {
+
+template <typename Callback>
+static inline void forEachKey(std::string_view keypath, Callback callback)
+{
+    while (!keypath.empty()) {
+        auto found = keypath.find('\\');
+        callback(keypath.substr(0, found));
+        if (found == std::string_view::npos) {
+            break;
+        }
+        keypath.remove_prefix(found + 1);
+    }
+}
+
+/*!
+ * \brief Hash of instruction within its key: value name ignoring ASCII case, type and data.
+ * Keypath is the position of node.
+ */
+static inline uint64_t hashOwn(const PolicyInstruction &instruction)
+{
+    return hashData(instruction.data,
+                    hashCombine(hashFolded(instruction.value),
+                                static_cast<uint64_t>(instruction.type)));
+}
+
+/*!
+ * \brief Compute hashes of subtree bottom-up. Traversal keeps its own stack, keypaths may be
+ * deeper than the call stack allows.
+ */
+static void computeHash(PolicyHashNode &root)
+{
+    // Node is hashed when it is met the second time, after all of its subkeys.
+    std::vector<std::pair<PolicyHashNode *, bool>> pending{ { &root, false } };
+
+    while (!pending.empty()) {
+        auto [node, visited] = pending.back();
+
+        if (!visited) {
+            pending.back().second = true;
+            for (auto &subkey : node->subkeys) {
+                pending.emplace_back(subkey.second.get(), false);
+            }
+            continue;
+        }
+
+        pending.pop_back();
+        uint64_t hash = hashCombine(node->own, node->count);
+        for (auto &subkey : node->subkeys) {
+            // Subkeys are keyed by lowercase names, so spelling does not change hash.
+            hash = hashCombine(hashString(subkey.first, hash), subkey.second->hash);
+        }
+        node->hash = hash;
+    }
+}
+
+/*!
+ * \brief Key met by difference walk: name and index of parent key, `npos` for root
+ */
+typedef struct DifferencePath
+{
+    size_t parent{};
+    const std::string *name{};
+} DifferencePath;
+
+/*!
+ * \brief Step of difference walk: compare pair of nodes, or report keypath if `lhs` is null
+ */
+typedef struct DifferenceStep
+{
+    const PolicyHashNode *lhs{};
+    const PolicyHashNode *rhs{};
+    size_t path{};
+} DifferenceStep;
+
+static std::string joinKeypath(const std::vector<DifferencePath> &paths, size_t path)
+{
+    std::vector<const std::string *> names;
+    size_t length = 0;
+    for (; path != std::string::npos; path = paths[path].parent) {
+        names.push_back(paths[path].name);
+        length += paths[path].name->size() + 1;
+    }
+
+    std::string keypath;
+    keypath.reserve(length);
+    for (auto name = names.rbegin(); name != names.rend(); ++name) {
+        if (!keypath.empty()) {
+            keypath.push_back('\\');
+        }
+        keypath += **name;
+    }
+    return keypath;
+}
+
+/*!
+ * \brief Collect difference depth-first with own stack, like `computeHash`. Keypaths are
+ * kept as parent links and joined only when reported, deep trees are walked in linear time.
+ */
+static void collectDifference(const PolicyHashNode &lhs, const PolicyHashNode &rhs,
+                              std::vector<std::string> &result)
+{
+    std::vector<DifferencePath> paths;
+    std::vector<DifferenceStep> pending;
+    std::vector<DifferenceStep> steps;
+
+    pending.push_back({ &lhs, &rhs, std::string::npos });
+    while (!pending.empty()) {
+        auto step = pending.back();
+        pending.pop_back();
+
+        if (step.lhs == nullptr) {
+            result.push_back(joinKeypath(paths, step.path));
+            continue;
+        }
+        if (step.lhs->hash == step.rhs->hash) {
+            continue;
+        }
+        if (step.lhs->own != step.rhs->own) {
+            result.push_back(joinKeypath(paths, step.path));
+        }
+
+        // Subkeys are ordered by lowercase name, so both lists are merged. Keypaths are reported
+        // as spelled in `lhs` for keys of both trees. Steps are pushed in reverse,
+        // so they are taken in order.
+        auto left = step.lhs->subkeys.begin();
+        auto right = step.rhs->subkeys.begin();
+        auto leftEnd = step.lhs->subkeys.end();
+        auto rightEnd = step.rhs->subkeys.end();
+        steps.clear();
+        while (left != leftEnd || right != rightEnd) {
+            if (right == rightEnd || (left != leftEnd && left->first < right->first)) {
+                paths.push_back({ step.path, &left->second->name });
+                steps.push_back({ nullptr, nullptr, paths.size() - 1 });
+                ++left;
+            } else if (left == leftEnd || right->first < left->first) {
+                paths.push_back({ step.path, &right->second->name });
+                steps.push_back({ nullptr, nullptr, paths.size() - 1 });
+                ++right;
+            } else {
+                paths.push_back({ step.path, &left->second->name });
+                steps.push_back({ left->second.get(), right->second.get(), paths.size() - 1 });
+                ++left;
+                ++right;
+            }
+        }
+        pending.insert(pending.end(), steps.rbegin(), steps.rend());
+    }
+}
+
+PolicyHashNode::~PolicyHashNode()
+{
+    releaseSubtrees(subkeys, &PolicyHashNode::subkeys);
+}
+
+PolicyHashTree PolicyHashTree::build(const PolicyFile &file)
+{
+    PolicyHashTree tree;
+
+    for (const auto &instruction : file.instructions) {
+        tree.add(instruction);
+    }
+    tree.finish();
+
+    return tree;
+}
+
+void PolicyHashTree::add(const PolicyInstruction &instruction)
+{
+    PolicyHashNode *current = &m_root;
+
+    ++current->count;
+    forEachKey(instruction.key, [&current](std::string_view name) {
+        auto folded = foldCase(name);
+        auto found = current->subkeys.find(folded);
+        if (found == current->subkeys.end()) {
+            auto child = std::make_unique<PolicyHashNode>();
+            child->name = std::string(name);
+            found = current->subkeys.emplace(std::move(folded), std::move(child)).first;
+        }
+        current = found->second.get();
+        ++current->count;
+    });
+
+    current->own = hashCombine(current->own, hashOwn(instruction));
+    m_finished = false;
+}
+
+void PolicyHashTree::finish()
+{
+    if (!m_finished) {
+        computeHash(m_root);
+        m_finished = true;
+    }
+}
+
+const PolicyHashNode &PolicyHashTree::root() const
+{
+    return m_root;
+}
+
+uint64_t PolicyHashTree::hash() const
+{
+    return m_root.hash;
+}
+
+const PolicyHashNode *PolicyHashTree::find(std::string_view keypath) const
+{
+    const PolicyHashNode *current = &m_root;
+
+    forEachKey(keypath, [&current](std::string_view name) {
+        if (current == nullptr) {
+            return;
+        }
+        auto found = current->subkeys.find(foldCase(name));
+        current = found == current->subkeys.end() ? nullptr : found->second.get();
+    });
+
+    return current;
+}
+
+std::vector<std::string> PolicyHashTree::difference(const PolicyHashTree &other) const
+{
+    std::vector<std::string> result;
+
+    collectDifference(m_root, other.m_root, result);
+
+    return result;
+}
+
+} // namespace pol
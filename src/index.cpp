@@ -0,0 +1,144 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+
+#include <binary.h>
+#include <casefold.h>
+#include <index.h>
+
+namespace pol {
+
+/*!
+ * \brief Index signature `PIDX`, LE
+ */
+static const uint32_t index_magic = 0x58444950;
+static const uint32_t index_version = 2;
+
+/*!
+ * \brief Hash of (keypath, value) ignoring ASCII case, like policy is applied
+ */
+static inline uint64_t hashName(std::string_view keypath, std::string_view value)
+{
+    return hashFolded(value, hashFolded(keypath));
+}
+
+static inline bool entryLess(const PolicyIndexEntry &lhs, const PolicyIndexEntry &rhs)
+{
+    return lhs.hash < rhs.hash || (lhs.hash == rhs.hash && lhs.offset < rhs.offset);
+}
+
+PolicyIndex PolicyIndex::build(PRegParser &parser, std::istream &policy)
+{
+    PolicyIndex index;
+    auto infos = parser.scanMetadata(policy);
+
+    index.m_entries.reserve(infos.size());
+    for (const auto &info : infos) {
+        index.m_entries.push_back({ hashName(info.key, info.value), info.offset });
+    }
+    std::sort(index.m_entries.begin(), index.m_entries.end(), entryLess);
+
+    // Instruction ends with data and `]`, file ends with the last instruction.
+    index.m_sourceSize = infos.empty() ? sizeof(uint64_t)
+                                       : infos.back().dataOffset + infos.back().size + 2;
+
+    return index;
+}
+
+PolicyIndex PolicyIndex::load(std::istream &stream)
+{
+    PolicyIndex index;
+
+    if (readIntegralFromBuffer<uint32_t>(stream) != index_magic) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Encountered with invalid index signature.");
+    }
+    if (readIntegralFromBuffer<uint32_t>(stream) != index_version) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Encountered with unsupported index version.");
+    }
+
+    index.m_sourceSize = readIntegralFromBuffer<uint64_t>(stream);
+    auto count = readIntegralFromBuffer<uint64_t>(stream);
+
+    // Count is not trusted, so memory is reserved only for reasonable amount of entries.
+    index.m_entries.reserve(std::min<uint64_t>(count, 1 << 16));
+    for (uint64_t i = 0; i < count; ++i) {
+        PolicyIndexEntry entry;
+        entry.hash = readIntegralFromBuffer<uint64_t>(stream);
+        entry.offset = readIntegralFromBuffer<uint64_t>(stream);
+
+        if (!index.m_entries.empty() && entryLess(entry, index.m_entries.back())) {
+            throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                     + ", Encountered with unsorted index.");
+        }
+        index.m_entries.push_back(entry);
+    }
+
+    return index;
+}
+
+void PolicyIndex::save(std::ostream &stream) const
+{
+    writeIntegralToBuffer<uint32_t>(stream, index_magic);
+    writeIntegralToBuffer<uint32_t>(stream, index_version);
+    writeIntegralToBuffer<uint64_t>(stream, m_sourceSize);
+    writeIntegralToBuffer<uint64_t>(stream, m_entries.size());
+
+    for (const auto &entry : m_entries) {
+        writeIntegralToBuffer<uint64_t>(stream, entry.hash);
+        writeIntegralToBuffer<uint64_t>(stream, entry.offset);
+    }
+}
+
+std::vector<uint64_t> PolicyIndex::find(std::string_view keypath, std::string_view value) const
+{
+    std::vector<uint64_t> result;
+    PolicyIndexEntry key{ hashName(keypath, value), 0 };
+
+    auto found = std::lower_bound(m_entries.begin(), m_entries.end(), key, entryLess);
+    for (; found != m_entries.end() && found->hash == key.hash; ++found) {
+        result.push_back(found->offset);
+    }
+
+    return result;
+}
+
+std::optional<PolicyInstruction> PolicyIndex::lookup(PRegParser &parser, std::istream &policy,
+                                                     std::string_view keypath,
+                                                     std::string_view value) const
+{
+    auto offsets = find(keypath, value);
+
+    // The last instruction wins, like it does when policy is applied.
+    for (auto offset = offsets.rbegin(); offset != offsets.rend(); ++offset) {
+        policy.clear();
+        policy.seekg(static_cast<std::streamoff>(*offset));
+
+        auto instruction = parser.parseInstruction(policy);
+        if (equalFolded(instruction.key, keypath) && equalFolded(instruction.value, value)) {
+            return { std::move(instruction) };
+        }
+    }
+
+    return {};
+}
+
+} // namespace pol
@@ -0,0 +1,86 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+
+#include <layout.h>
+
+namespace pol {
+
+void encodeData(const PolicyData &data, std::string &target)
+{
+    if (auto string = std::get_if<std::string>(&data)) {
+        target.append(*string);
+    } else if (auto strings = std::get_if<std::vector<std::string>>(&data)) {
+        for (const auto &item : *strings) {
+            target.append(item);
+            target.push_back('\0');
+        }
+    } else if (auto binary = std::get_if<std::vector<uint8_t>>(&data)) {
+        target.append(reinterpret_cast<const char *>(binary->data()), binary->size());
+    } else if (auto number = std::get_if<uint32_t>(&data)) {
+        target.append(reinterpret_cast<const char *>(number), sizeof(*number));
+    } else {
+        auto wide = std::get<uint64_t>(data);
+        target.append(reinterpret_cast<const char *>(&wide), sizeof(wide));
+    }
+}
+
+PolicyData decodeData(PolicyDataAlternative alternative, std::string_view bytes)
+{
+    switch (alternative) {
+    case PolicyDataAlternative::String:
+        return std::string(bytes);
+    case PolicyDataAlternative::Strings: {
+        std::vector<std::string> result;
+
+        // Every string is followed by '\0'.
+        for (size_t begin = 0; begin < bytes.size();) {
+            auto end = bytes.find('\0', begin);
+            result.emplace_back(bytes.substr(begin, end - begin));
+            begin = end + 1;
+        }
+        return result;
+    }
+    case PolicyDataAlternative::Binary:
+        return std::vector<uint8_t>(bytes.begin(), bytes.end());
+    case PolicyDataAlternative::Dword:
+        return static_cast<uint32_t>(decodeInteger(alternative, bytes));
+    default:
+        return decodeInteger(alternative, bytes);
+    }
+}
+
+uint64_t decodeInteger(PolicyDataAlternative alternative, std::string_view bytes)
+{
+    if (alternative == PolicyDataAlternative::Dword) {
+        uint32_t number;
+        memcpy(&number, bytes.data(), sizeof(number));
+        return number;
+    }
+    if (alternative == PolicyDataAlternative::Qword) {
+        uint64_t number;
+        memcpy(&number, bytes.data(), sizeof(number));
+        return number;
+    }
+
+    return 0;
+}
+
+} // namespace pol
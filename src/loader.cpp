@@ -0,0 +1,452 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#  define PARSEPOL_HAVE_IO_URING
+#  include <linux/io_uring.h>
+#  include <sched.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <sys/uio.h>
+#endif
+
+#include <loader.h>
+
+namespace pol {
+
+static inline std::string systemError(const std::string &what, const std::string &path, int code)
+{
+    return "Failed to " + what + " file " + path + ": " + strerror(code) + ".";
+}
+
+/*!
+ * \brief Open file and allocate buffer of its size. Return descriptor or -1 (error is stored).
+ */
+static int openFile(const std::string &path, LoadedFile &file)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        file.error = systemError("open", path, errno);
+        return -1;
+    }
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        file.error = systemError("stat", path, errno);
+        ::close(fd);
+        return -1;
+    }
+
+    file.data.resize(static_cast<size_t>(info.st_size));
+    return fd;
+}
+
+/*!
+ * \brief Read file with `pread` into buffer allocated by `openFile`
+ */
+static void readFile(const std::string &path, LoadedFile &file)
+{
+    int fd = openFile(path, file);
+    if (fd < 0) {
+        return;
+    }
+
+    size_t done = 0;
+    while (done < file.data.size()) {
+        auto ret = ::pread(fd, file.data.data() + done, file.data.size() - done, done);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret < 0) {
+            file.error = systemError("read", path, errno);
+            break;
+        }
+        if (ret == 0) {
+            // File was truncated after `fstat`.
+            file.data.resize(done);
+            break;
+        }
+        done += static_cast<size_t>(ret);
+    }
+
+    ::close(fd);
+}
+
+#ifdef PARSEPOL_HAVE_IO_URING
+
+/*!
+ * \brief Minimal io_uring wrapper over raw system calls (liburing is not required)
+ */
+class IoUring final
+{
+public:
+    explicit IoUring(unsigned entries)
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+
+        m_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (m_fd < 0) {
+            return;
+        }
+
+        m_sqSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        m_cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            m_sqSize = m_cqSize = std::max(m_sqSize, m_cqSize);
+        }
+
+        m_sq = ::mmap(nullptr, m_sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd,
+                      IORING_OFF_SQ_RING);
+        m_cq = (params.features & IORING_FEAT_SINGLE_MMAP)
+                ? m_sq
+                : ::mmap(nullptr, m_cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         m_fd, IORING_OFF_CQ_RING);
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = ::mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        m_fd, IORING_OFF_SQES);
+
+        if (m_sq == MAP_FAILED || m_cq == MAP_FAILED || m_sqes == MAP_FAILED) {
+            release();
+            return;
+        }
+
+        auto sq = static_cast<uint8_t *>(m_sq);
+        auto cq = static_cast<uint8_t *>(m_cq);
+        m_sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        m_sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        m_sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        m_sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        m_cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        m_cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        m_cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        m_entries = params.sq_entries;
+    }
+
+    ~IoUring() { release(); }
+
+    inline bool valid() const { return m_fd >= 0; }
+    inline unsigned entries() const { return m_entries; }
+
+    /*!
+     * \brief Queue read of `size` bytes at `offset`. Caller must not queue more than `entries()`
+     * requests between `submit` calls.
+     */
+    void queueRead(int fd, void *buffer, size_t size, uint64_t offset, uint64_t userData)
+    {
+        unsigned tail = *m_sqTail;
+        unsigned index = tail & m_sqMask;
+        auto &sqe = static_cast<io_uring_sqe *>(m_sqes)[index];
+
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = fd;
+        sqe.addr = reinterpret_cast<uint64_t>(buffer);
+        sqe.len = static_cast<uint32_t>(std::min<size_t>(size, 1U << 30));
+        sqe.off = offset;
+        sqe.user_data = userData;
+
+        m_sqArray[index] = index;
+        __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+        ++m_queued;
+    }
+
+    /*!
+     * \brief Submit queued requests and wait for at least one completion
+     */
+    void submitAndWait()
+    {
+        while (true) {
+            auto ret = ::syscall(__NR_io_uring_enter, m_fd, m_queued, 1, IORING_ENTER_GETEVENTS,
+                                 nullptr, 0);
+            if (ret >= 0) {
+                m_queued -= static_cast<unsigned>(ret);
+                m_inflight += static_cast<unsigned>(ret);
+                return;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: "
+                                         + __FILE__ + ", io_uring_enter failed: "
+                                         + strerror(errno) + ".");
+            }
+        }
+    }
+
+    /*!
+     * \brief Pass every available completion to `callback(userData, result)`. Completion is
+     * consumed before callback is called, so callback may throw.
+     */
+    template <typename Callback>
+    void reap(Callback &&callback)
+    {
+        unsigned head = *m_cqHead;
+        unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+
+        for (; head != tail; ++head) {
+            const auto &cqe = m_cqes[head & m_cqMask];
+            auto userData = cqe.user_data;
+            auto result = cqe.res;
+
+            __atomic_store_n(m_cqHead, head + 1, __ATOMIC_RELEASE);
+            --m_inflight;
+            callback(userData, result);
+        }
+    }
+
+    /*!
+     * \brief Wait for every submitted request, dropping results. Kernel writes into buffers of
+     * requests in flight, so they must outlive them. Queued requests are never submitted.
+     */
+    void drain()
+    {
+        while (m_inflight > 0) {
+            if (::syscall(__NR_io_uring_enter, m_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0
+                && errno != EINTR) {
+                // Completions are posted into ring anyway, so they are polled.
+                ::sched_yield();
+            }
+            reap([](uint64_t, int32_t) {});
+        }
+    }
+
+private:
+    IoUring(const IoUring &) = delete;
+    void operator=(const IoUring &) = delete;
+
+    void release()
+    {
+        if (m_sqes != nullptr && m_sqes != MAP_FAILED) {
+            ::munmap(m_sqes, m_sqesSize);
+        }
+        if (m_cq != nullptr && m_cq != MAP_FAILED && m_cq != m_sq) {
+            ::munmap(m_cq, m_cqSize);
+        }
+        if (m_sq != nullptr && m_sq != MAP_FAILED) {
+            ::munmap(m_sq, m_sqSize);
+        }
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+        m_fd = -1;
+        m_sq = m_cq = m_sqes = nullptr;
+    }
+
+    int m_fd{ -1 };
+    unsigned m_entries{};
+    unsigned m_queued{};
+    unsigned m_inflight{};
+
+    void *m_sq{};
+    void *m_cq{};
+    void *m_sqes{};
+    size_t m_sqSize{};
+    size_t m_cqSize{};
+    size_t m_sqesSize{};
+
+    unsigned *m_sqHead{};
+    unsigned *m_sqTail{};
+    unsigned m_sqMask{};
+    unsigned *m_sqArray{};
+    unsigned *m_cqHead{};
+    unsigned *m_cqTail{};
+    unsigned m_cqMask{};
+    io_uring_cqe *m_cqes{};
+};
+
+/*!
+ * \brief Descriptors of files being read, the ones still open are closed when reading stops,
+ * either normally or by exception.
+ */
+class Descriptors final
+{
+public:
+    explicit Descriptors(size_t count) : m_descriptors(count, -1) { }
+    ~Descriptors()
+    {
+        for (int fd : m_descriptors) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+    }
+
+    int &operator[](size_t index) { return m_descriptors[index]; }
+
+private:
+    Descriptors(const Descriptors &) = delete;
+    void operator=(const Descriptors &) = delete;
+
+    std::vector<int> m_descriptors;
+};
+
+/*!
+ * \brief Waits for reads in flight when reading stops, either normally or by exception.
+ * Declared after buffers and descriptors, so it runs before they are released.
+ */
+class Drain final
+{
+public:
+    explicit Drain(IoUring &ring) : m_ring(ring) { }
+    ~Drain() { m_ring.drain(); }
+
+private:
+    Drain(const Drain &) = delete;
+    void operator=(const Drain &) = delete;
+
+    IoUring &m_ring;
+};
+
+/*!
+ * \brief Read files through io_uring, up to `ring.entries()` reads are in flight.
+ * Short reads are resubmitted for the rest of file. Every file is passed to `callback` as soon
+ * as it is read.
+ */
+static void readFiles(IoUring &ring, const std::vector<std::string> &paths,
+                      const LoadCallback &callback)
+{
+    std::vector<LoadedFile> files(paths.size());
+    Descriptors descriptors(paths.size());
+    Drain drain(ring);
+    std::vector<size_t> done(paths.size(), 0);
+    std::vector<size_t> pending;
+    size_t next = 0;
+    size_t inflight = 0;
+
+    auto finish = [&](size_t index) {
+        ::close(descriptors[index]);
+        descriptors[index] = -1;
+        --inflight;
+        callback(index, std::move(files[index]));
+    };
+
+    while (next < paths.size() || inflight > 0) {
+        // Requests which were completed partially go first.
+        for (auto index : pending) {
+            ring.queueRead(descriptors[index], files[index].data.data() + done[index],
+                           files[index].data.size() - done[index], done[index], index);
+        }
+        pending.clear();
+
+        while (next < paths.size() && inflight < ring.entries()) {
+            size_t index = next++;
+            int fd = openFile(paths[index], files[index]);
+            if (fd < 0) {
+                callback(index, std::move(files[index]));
+                continue;
+            }
+            if (files[index].data.empty()) {
+                ::close(fd);
+                callback(index, std::move(files[index]));
+                continue;
+            }
+
+            descriptors[index] = fd;
+            ++inflight;
+            ring.queueRead(fd, files[index].data.data(), files[index].data.size(), 0, index);
+        }
+
+        if (inflight == 0) {
+            continue;
+        }
+
+        ring.submitAndWait();
+        ring.reap([&](uint64_t index, int32_t result) {
+            if (result == -EINVAL || result == -EOPNOTSUPP) {
+                // Kernel does not support IORING_OP_READ (before Linux 5.6).
+                files[index] = {};
+                readFile(paths[index], files[index]);
+                finish(index);
+                return;
+            }
+            if (result < 0) {
+                files[index].error = systemError("read", paths[index], -result);
+                finish(index);
+                return;
+            }
+            if (result == 0) {
+                // File was truncated after `fstat`.
+                files[index].data.resize(done[index]);
+                finish(index);
+                return;
+            }
+
+            done[index] += static_cast<size_t>(result);
+            if (done[index] == files[index].data.size()) {
+                finish(index);
+            } else {
+                pending.push_back(index);
+            }
+        });
+    }
+}
+
+#endif // PARSEPOL_HAVE_IO_URING
+
+bool isIoUringAvailable()
+{
+#ifdef PARSEPOL_HAVE_IO_URING
+    return IoUring(1).valid();
+#else
+    return false;
+#endif
+}
+
+std::vector<LoadedFile> loadFiles(const std::vector<std::string> &paths, size_t queueDepth)
+{
+    std::vector<LoadedFile> files(paths.size());
+
+    loadFiles(
+            paths,
+            [&files](size_t index, LoadedFile &&file) { files[index] = std::move(file); },
+            queueDepth);
+
+    return files;
+}
+
+void loadFiles(const std::vector<std::string> &paths, const LoadCallback &callback,
+               size_t queueDepth)
+{
+#ifdef PARSEPOL_HAVE_IO_URING
+    if (paths.size() > 1) {
+        IoUring ring(static_cast<unsigned>(std::clamp<size_t>(queueDepth, 1, 4096)));
+        if (ring.valid()) {
+            readFiles(ring, paths, callback);
+            return;
+        }
+    }
+#endif
+
+    for (size_t i = 0; i < paths.size(); ++i) {
+        LoadedFile file;
+        readFile(paths[i], file);
+        callback(i, std::move(file));
+    }
+}
+
+} // namespace pol
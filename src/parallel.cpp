@@ -0,0 +1,371 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <loader.h>
+#include <parallel.h>
+
+namespace pol {
+
+/*!
+ * \brief Instructions materialized by one task. Small files are not worth waking threads up.
+ */
+static const size_t instructions_per_task = 1024;
+
+/*!
+ * \brief Files loaded by `parseMany` with batch read and waiting for worker, as many as reads
+ * `loadFiles` keeps in flight by default
+ */
+static const size_t load_queue_size = 64;
+
+static inline size_t getThreadCount(size_t threads)
+{
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    return std::max<size_t>(threads, 1);
+}
+
+/*!
+ * \brief Run `task(worker, index)` for every index in [0, tasks) on up to `threads` threads
+ * (calling thread included). Workers take next index from shared counter, so faster workers take
+ * more tasks. `task` must not throw.
+ */
+template <typename Task>
+static void runTasks(size_t threads, size_t tasks, Task &&task)
+{
+    std::atomic<size_t> next{ 0 };
+    std::vector<std::thread> workers;
+
+    auto work = [&next, &task, tasks](size_t worker) {
+        for (size_t index = next++; index < tasks; index = next++) {
+            task(worker, index);
+        }
+    };
+
+    threads = std::min(threads, tasks);
+    for (size_t worker = 1; worker < threads; ++worker) {
+        try {
+            workers.emplace_back(work, worker);
+        } catch (const std::system_error &) {
+            // Unable to start more threads, the rest work is shared by started ones.
+            break;
+        }
+    }
+
+    work(0);
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+PolicyFile parseParallel(const uint8_t *data, size_t size, size_t threads,
+                         const ParseLimits &limits, const ParseOptions &options)
+{
+    auto bounds = scanInstructions(data, size);
+    ParseUsage usage;
+
+    for (const auto &instructionBounds : bounds) {
+        checkLimits(limits, usage, data, instructionBounds);
+    }
+
+    PolicyTree instructions(bounds.size());
+
+    size_t tasks = (bounds.size() + instructions_per_task - 1) / instructions_per_task;
+    threads = std::min(getThreadCount(threads), tasks);
+
+    // Parser owns iconv descriptors, which can not be shared between threads.
+    std::vector<std::unique_ptr<PRegParser>> parsers;
+    for (size_t i = 0; i < threads; ++i) {
+        parsers.push_back(createPregParser());
+    }
+    std::vector<std::exception_ptr> errors(tasks);
+    std::vector<PolicyFingerprint> fingerprints(tasks);
+
+    runTasks(threads, tasks, [&](size_t worker, size_t task) {
+        size_t begin = task * instructions_per_task;
+        size_t end = std::min(begin + instructions_per_task, bounds.size());
+
+        try {
+            for (size_t i = begin; i < end; ++i) {
+                instructions[i] = parsers[worker]->materialize(data, bounds[i]);
+                if (options.fingerprint) {
+                    fingerprints[task].add(instructions[i]);
+                }
+            }
+        } catch (...) {
+            errors[task] = std::current_exception();
+        }
+    });
+
+    for (const auto &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    PolicyFile file{ std::move(instructions) };
+
+    // Fingerprint is order-insensitive, so parts of tasks are summed in any order.
+    if (options.fingerprint) {
+        file.parsedFingerprint.emplace();
+        for (const auto &fingerprint : fingerprints) {
+            file.parsedFingerprint->merge(fingerprint);
+        }
+    }
+
+    return file;
+}
+
+/*!
+ * \brief Read whole file into `buffer`, reusing its memory
+ */
+static void readFile(const std::string &path, std::vector<uint8_t> &buffer)
+{
+    std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!file) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Failed to open file " + path + ".");
+    }
+
+    auto size = file.tellg();
+    file.seekg(0);
+    buffer.resize(static_cast<size_t>(size));
+    file.read(reinterpret_cast<char *>(buffer.data()), size);
+    if (!file) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Failed to read file " + path + ".");
+    }
+}
+
+/*!
+ * \brief State of one worker of `parseMany`: parser (iconv descriptors can not be shared
+ * between threads), reused file buffer and its own copy of filter
+ */
+typedef struct ParseWorker
+{
+    std::unique_ptr<PRegParser> parser{};
+    std::vector<uint8_t> buffer{};
+    PolicyFilter filter{};
+} ParseWorker;
+
+static std::vector<ParseWorker> makeWorkers(size_t threads, const ParseManyOptions &options)
+{
+    std::vector<ParseWorker> workers(threads);
+
+    for (auto &worker : workers) {
+        worker.parser = createPregParser();
+        worker.parser->setLimits(options.limits);
+        worker.parser->setParseOptions(options.parse);
+        worker.filter = options.filter;
+    }
+
+    return workers;
+}
+
+/*!
+ * \brief Run `parse(worker, index)` for every file on worker pool and collect results
+ */
+template <typename Parse>
+static std::vector<ParseResult> parseEach(size_t files, const ParseManyOptions &options,
+                                          Parse &&parse)
+{
+    std::vector<ParseResult> results(files);
+    size_t threads = std::min(getThreadCount(options.threads), std::max<size_t>(files, 1));
+    auto workers = makeWorkers(threads, options);
+
+    runTasks(threads, files, [&](size_t worker, size_t index) {
+        try {
+            results[index].file = parse(workers[worker], index);
+        } catch (const std::exception &e) {
+            results[index].error = e.what();
+        }
+    });
+
+    return results;
+}
+
+/*!
+ * \brief Files passed from loader to parsing workers, up to `limit` files are queued
+ */
+class LoadedQueue final
+{
+public:
+    explicit LoadedQueue(size_t limit) : m_limit(limit) { }
+
+    /*!
+     * \brief Queue file, it is left intact if queue is full
+     * \return false if queue is full
+     */
+    bool tryPush(size_t index, LoadedFile &file)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_files.size() == m_limit) {
+            return false;
+        }
+        m_files.emplace_back(index, std::move(file));
+        // Only idle workers wait, they are woken when queue stops being empty.
+        if (m_files.size() == 1) {
+            m_notEmpty.notify_all();
+        }
+        return true;
+    }
+    /*!
+     * \brief Take next file, wait for it while queue is open.
+     * \return false if queue is closed and empty
+     */
+    bool pop(size_t &index, LoadedFile &file)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this]() { return !m_files.empty() || m_closed; });
+        if (m_files.empty()) {
+            return false;
+        }
+
+        index = m_files.front().first;
+        file = std::move(m_files.front().second);
+        m_files.pop_front();
+        return true;
+    }
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notEmpty.notify_all();
+    }
+
+private:
+    LoadedQueue(const LoadedQueue &) = delete;
+    void operator=(const LoadedQueue &) = delete;
+
+    std::mutex m_mutex{};
+    std::condition_variable m_notEmpty{};
+    std::deque<std::pair<size_t, LoadedFile>> m_files{};
+    size_t m_limit{};
+    bool m_closed{};
+};
+
+static void parseLoaded(ParseWorker &worker, size_t index, LoadedFile &&file,
+                        std::vector<ParseResult> &results)
+{
+    // Buffer is released as soon as file is parsed.
+    auto loaded = std::move(file);
+
+    if (!loaded.ok()) {
+        results[index].error = std::move(loaded.error);
+        return;
+    }
+    try {
+        results[index].file = worker.parser->parse(loaded.data.data(), loaded.data.size(),
+                                                   worker.filter);
+    } catch (const std::exception &e) {
+        results[index].error = e.what();
+    }
+}
+
+/*!
+ * \brief Calling thread loads files by `loadFiles` and queues them as they complete, workers
+ * parse them meanwhile. Calling thread is one of `threads`: it parses file itself when queue is
+ * full, so only files being read, queued or parsed are kept in memory. Kernel goes on with
+ * reads in flight while the loader parses.
+ */
+static std::vector<ParseResult> parseLoading(const std::vector<std::string> &paths,
+                                             const ParseManyOptions &options)
+{
+    std::vector<ParseResult> results(paths.size());
+    size_t threads = std::min(getThreadCount(options.threads), std::max<size_t>(paths.size(), 1));
+    auto workers = makeWorkers(threads, options);
+    LoadedQueue queue(load_queue_size);
+    std::vector<std::thread> pool;
+
+    for (size_t i = 1; i < workers.size(); ++i) {
+        auto &worker = workers[i];
+        try {
+            pool.emplace_back([&worker, &queue, &results]() {
+                size_t index = 0;
+                LoadedFile file;
+                while (queue.pop(index, file)) {
+                    parseLoaded(worker, index, std::move(file), results);
+                }
+            });
+        } catch (const std::system_error &) {
+            break;
+        }
+    }
+
+    std::exception_ptr error;
+    try {
+        loadFiles(paths, [&](size_t index, LoadedFile &&file) {
+            if (pool.empty() || !queue.tryPush(index, file)) {
+                parseLoaded(workers[0], index, std::move(file), results);
+            }
+        });
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    queue.close();
+    for (auto &thread : pool) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    return results;
+}
+
+std::vector<ParseResult> parseMany(const std::vector<std::string> &paths,
+                                   const ParseManyOptions &options)
+{
+    if (options.batchRead) {
+        return parseLoading(paths, options);
+    }
+
+    return parseEach(paths.size(), options,
+                     [&paths](ParseWorker &worker, size_t index) {
+                         readFile(paths[index], worker.buffer);
+                         return worker.parser->parse(worker.buffer.data(), worker.buffer.size(),
+                                                     worker.filter);
+                     });
+}
+
+std::vector<ParseResult> parseMany(const std::vector<std::vector<uint8_t>> &buffers,
+                                   const ParseManyOptions &options)
+{
+    return parseEach(buffers.size(), options,
+                     [&buffers](ParseWorker &worker, size_t index) {
+                         const auto &buffer = buffers[index];
+                         return worker.parser->parse(buffer.data(), buffer.size(), worker.filter);
+                     });
+}
+
+} // namespace pol
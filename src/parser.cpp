@@ -17,22 +17,23 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
-#include <sstream>
+#include <cassert>
+#include <cctype>
+#include <cstring>
 #include <vector>
 
 #include <binary.h>
+#include <canonical.h>
 #include <common.h>
+#include <hash.h>
 #include <parser.h>
 
 namespace pol {
 
 /*!
- * \brief Valid POL Registery file header. Binary equal valid header.
- * leToNative is used because the entry 0x0167655250 is 
- * equivalent to the header in case uint64_t stores a number in LittleEndian.
- * BigEndian - 0x00 0x00 0x00 0x01 0x67 0x65 0x52 0x50 (bytes must be swaped)
+ * \brief Read ahead block size of `parseInstruction`
  */
-static const uint64_t valid_header = leToNative<uint64_t>(0x0167655250);
+static const size_t instruction_block_size = 4096;
 
 /*!
  * \brief Match regex `[\x20-\x7E]`
@@ -42,49 +43,479 @@ static inline bool isValueCharacter(uint8_t sym)
     return sym >= 0x20 && sym <= 0x7E;
 }
 
+/*!
+ * \brief Get DWORD/QWORD data from memory. Size must match the type, like reading from stream
+ * fails when the number is not followed by `]`.
+ */
+static inline PolicyData getIntegralData(const uint8_t *data, PolicyRegType type, uint32_t size)
+{
+    bool isQword = type == PolicyRegType::REG_QWORD_LITTLE_ENDIAN
+            || type == PolicyRegType::REG_QWORD_BIG_ENDIAN;
+
+    if (size != (isQword ? sizeof(uint64_t) : sizeof(uint32_t))) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Unexpected size " + std::to_string(size)
+                                 + " of integral number.");
+    }
+
+    switch (type) {
+    case PolicyRegType::REG_DWORD_LITTLE_ENDIAN:
+        return { readIntegralFromMemory<uint32_t, true>(data) };
+    case PolicyRegType::REG_DWORD_BIG_ENDIAN:
+        return { readIntegralFromMemory<uint32_t, false>(data) };
+    case PolicyRegType::REG_QWORD_LITTLE_ENDIAN:
+        return { readIntegralFromMemory<uint64_t, true>(data) };
+    default:
+        return { readIntegralFromMemory<uint64_t, false>(data) };
+    }
+}
+
 PRegParser::PRegParser()
 {
     this->m_iconvReadId = ::iconv_open("UTF-8", "UTF-16LE");
     this->m_iconvWriteId = ::iconv_open("UTF-16LE", "UTF-8");
 }
 
+void PRegParser::setLimits(const ParseLimits &limits)
+{
+    m_limits = limits;
+}
+
+const ParseLimits &PRegParser::getLimits() const
+{
+    return m_limits;
+}
+
+void PRegParser::setParseOptions(const ParseOptions &options)
+{
+    m_parseOptions = options;
+}
+
+const ParseOptions &PRegParser::getParseOptions() const
+{
+    return m_parseOptions;
+}
+
+void PRegParser::setWriteOptions(const WriteOptions &options)
+{
+    m_writeOptions = options;
+}
+
+const WriteOptions &PRegParser::getWriteOptions() const
+{
+    return m_writeOptions;
+}
+
+/*!
+ * \brief Size of instruction in binary form by sizes of its keypath, value and data in bytes
+ * (terminators excluded): brackets, separators, terminators, type and size take 24 bytes.
+ */
+static inline uint64_t getEncodedSize(uint64_t keypathSize, uint64_t valueSize,
+                                      uint64_t dataSize)
+{
+    return keypathSize + valueSize + dataSize + 24;
+}
+
+/*!
+ * \brief Types decoded by `readStringsFromMemory` into list of strings
+ */
+static inline bool isStringListType(PolicyRegType type)
+{
+    switch (type) {
+    case PolicyRegType::REG_MULTI_SZ:
+    case PolicyRegType::REG_RESOURCE_LIST:
+    case PolicyRegType::REG_FULL_RESOURCE_DESCRIPTOR:
+    case PolicyRegType::REG_RESOURCE_REQUIREMENTS_LIST:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static inline bool isStringType(PolicyRegType type)
+{
+    return type == PolicyRegType::REG_SZ || type == PolicyRegType::REG_EXPAND_SZ
+            || type == PolicyRegType::REG_LINK || isStringListType(type);
+}
+
+uint64_t getDecodedSize(uint64_t keypathSize, uint64_t valueSize, PolicyRegType type,
+                        uint64_t dataSize)
+{
+    uint64_t result = sizeof(PolicyInstruction) + (keypathSize + valueSize) / 2 * 3;
+
+    if (isStringType(type)) {
+        result += dataSize / 2 * 3;
+    } else if (type == PolicyRegType::REG_BINARY) {
+        result += dataSize;
+    }
+    return result;
+}
+
+uint64_t getStringsOverhead(PolicyRegType type, const uint8_t *data, uint64_t size)
+{
+    if (!isStringListType(type)) {
+        return 0;
+    }
+
+    uint64_t count = 0;
+    for (uint64_t offset = 0; offset + 1 < size; offset += 2) {
+        count += data[offset] == 0 && data[offset + 1] == 0;
+    }
+    return count * sizeof(std::string);
+}
+
+void chargeMemory(const ParseLimits &limits, ParseUsage &usage, uint64_t memorySize)
+{
+    usage.memory += memorySize;
+    if (usage.memory > limits.maxTotalSize) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Memory taken by instructions exceeds limit.");
+    }
+}
+
+void checkLimits(const ParseLimits &limits, ParseUsage &usage, const uint8_t *data,
+                 const PolicyInstructionBounds &bounds)
+{
+    checkLimits(limits, usage, bounds.dataOffset + bounds.size + 2 - bounds.offset,
+                getDecodedSize(bounds.keypathSize, bounds.valueSize, bounds.type, bounds.size));
+    chargeMemory(limits, usage, getStringsOverhead(bounds.type, data + bounds.dataOffset,
+                                                   bounds.size));
+}
+
+void checkLimits(const ParseLimits &limits, ParseUsage &usage, uint64_t instructionSize,
+                 uint64_t memorySize)
+{
+    if (instructionSize > limits.maxInstructionSize) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Instruction size " + std::to_string(instructionSize)
+                                 + " exceeds limit.");
+    }
+    if (++usage.instructions > limits.maxInstructionCount) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Instruction count exceeds limit.");
+    }
+    chargeMemory(limits, usage, memorySize);
+}
+
+void PolicyFingerprint::add(const PolicyInstruction &instruction)
+{
+    // Second half is independent hash of instruction, not derived from the first one.
+    low += hashInstruction(instruction);
+    high += hashInstruction(instruction, 0x9E3779B97F4A7C15ULL);
+}
+
+PolicyFingerprint PolicyFile::fingerprint() const
+{
+    return parsedFingerprint ? *parsedFingerprint : computeFingerprint(instructions);
+}
+
+PolicyFingerprint computeFingerprint(const PolicyTree &instructions)
+{
+    PolicyFingerprint result;
+
+    for (const auto &instruction : instructions) {
+        result.add(instruction);
+    }
+
+    return result;
+}
+
+bool isRawValid(const PolicyInstruction &instruction)
+{
+    assert(!instruction.raw.data || hashInstruction(instruction) == instruction.raw.digest);
+    return instruction.raw.data != nullptr;
+}
+
+PolicyFilter keypathPrefixFilter(std::string prefix)
+{
+    while (!prefix.empty() && prefix.back() == '\\') {
+        prefix.pop_back();
+    }
+
+    return [prefix = std::move(prefix)](std::string_view keypath, std::string_view) {
+        if (keypath.size() < prefix.size()
+            || (keypath.size() > prefix.size() && keypath[prefix.size()] != '\\')) {
+            return false;
+        }
+        for (size_t i = 0; i < prefix.size(); ++i) {
+            if (std::tolower(static_cast<uint8_t>(keypath[i]))
+                != std::tolower(static_cast<uint8_t>(prefix[i]))) {
+                return false;
+            }
+        }
+        return true;
+    };
+}
+
 PolicyFile PRegParser::parse(std::istream &stream)
+{
+    return parse(stream, {});
+}
+
+PolicyFile PRegParser::parse(std::istream &stream, const PolicyFilter &filter)
+{
+    StreamSource source(stream);
+
+    return parseFrom(source, filter);
+}
+
+template <typename Source>
+PolicyFile PRegParser::parseFrom(Source &source, const PolicyFilter &filter)
 {
     PolicyTree instructions;
 
-    parseHeader(stream);
+    m_usage = {};
+    m_fingerprint = {};
+    parseHeader(source);
 
-    stream.peek();
-    while (!stream.eof()) {
-        insertInstruction(stream, instructions);
-        stream.peek();
+    while (!source.eof()) {
+        insertInstruction(source, instructions, filter);
     }
 
-    return { instructions };
+    return finishParse(std::move(instructions));
 }
 
-bool PRegParser::write(std::ostream &stream, const PolicyFile &file)
+std::vector<PolicyInstructionInfo> PRegParser::scanMetadata(std::istream &stream)
 {
-    writeHeader(stream);
-    for (const auto &instruction : file.instructions) {
-        writeInstruction(stream, instruction, instruction.key, instruction.value);
+    std::vector<PolicyInstructionInfo> infos;
+    auto start = stream.tellg();
+    // Non-seekable streams have no position, offsets are counted from the header then.
+    auto base = start == std::istream::pos_type(-1) ? 0 : static_cast<uint64_t>(start);
+    StreamSource source(stream);
+
+    m_usage = {};
+    parseHeader(source);
+
+    while (!source.eof()) {
+        insertInstructionInfo(source, base, infos);
+    }
+
+    return infos;
+}
+
+PolicyInstruction PRegParser::parseInstruction(std::istream &stream)
+{
+    PolicyTree instructions;
+    // Single instruction is usually small, do not read ahead more than needed.
+    StreamSource source(stream, instruction_block_size);
+
+    m_usage = {};
+    insertInstruction(source, instructions, {});
+
+    return std::move(instructions.front());
+}
+
+PolicyFile PRegParser::parse(const uint8_t *data, size_t size)
+{
+    return parse(data, size, {});
+}
+
+PolicyFile PRegParser::parse(const uint8_t *data, size_t size, const PolicyFilter &filter)
+{
+    auto bounds = scanInstructions(data, size);
+    PolicyTree instructions;
+
+    accountInstructions(data, bounds);
+    m_fingerprint = {};
+
+    if (!filter) {
+        instructions.reserve(bounds.size());
     }
+    for (const auto &instructionBounds : bounds) {
+        PolicyInstruction instruction;
+
+        instruction.key = getKeypath(data + instructionBounds.offset + 2,
+                                     instructionBounds.keypathSize);
+        instruction.value = getValue(data + instructionBounds.valueOffset,
+                                     instructionBounds.valueSize);
+
+        if (filter && !filter(instruction.key, instruction.value)) {
+            validateType(instructionBounds.type);
+            continue;
+        }
+
+        materializeData(data, instructionBounds, instruction);
+        recordInstruction(instruction);
+        instructions.push_back(std::move(instruction));
+    }
+
+    return finishParse(std::move(instructions));
+}
+
+PolicyFile PRegParser::parse(std::shared_ptr<const void> owner, const uint8_t *data, size_t size)
+{
+    auto bounds = scanInstructions(data, size);
+    PolicyTree instructions;
+
+    accountInstructions(data, bounds);
+    m_fingerprint = {};
+
+    instructions.reserve(bounds.size());
+    for (const auto &instructionBounds : bounds) {
+        auto instruction = materialize(data, instructionBounds);
+
+        // Aliasing pointer: refers to instruction bytes, owns the whole buffer.
+        instruction.raw.data = std::shared_ptr<const uint8_t>(owner,
+                                                              data + instructionBounds.offset);
+        instruction.raw.size = instructionBounds.dataOffset + instructionBounds.size + 2
+                - instructionBounds.offset;
+#ifndef NDEBUG
+        instruction.raw.digest = hashInstruction(instruction);
+#endif
+        recordInstruction(instruction);
+        instructions.push_back(std::move(instruction));
+    }
+
+    return finishParse(std::move(instructions));
+}
+
+void PRegParser::recordInstruction(const PolicyInstruction &instruction)
+{
+    if (m_parseOptions.fingerprint) {
+        m_fingerprint.add(instruction);
+    }
+}
+
+PolicyFile PRegParser::finishParse(PolicyTree &&instructions)
+{
+    PolicyFile file{ std::move(instructions) };
+
+    if (m_parseOptions.fingerprint) {
+        file.parsedFingerprint = m_fingerprint;
+    }
+
+    return file;
+}
+
+void PRegParser::accountInstructions(const uint8_t *data,
+                                     const std::vector<PolicyInstructionBounds> &bounds)
+{
+    // Whole file is accounted before anything is decoded.
+    m_usage = {};
+    for (const auto &instructionBounds : bounds) {
+        checkLimits(m_limits, m_usage, data, instructionBounds);
+    }
+}
+
+PolicyInstruction PRegParser::materialize(const uint8_t *data,
+                                          const PolicyInstructionBounds &bounds)
+{
+    PolicyInstruction instruction;
+
+    instruction.key = getKeypath(data + bounds.offset + 2, bounds.keypathSize);
+    instruction.value = getValue(data + bounds.valueOffset, bounds.valueSize);
+    materializeData(data, bounds, instruction);
+
+    return instruction;
+}
+
+bool PRegParser::write(std::ostream &stream, const PolicyFile &file)
+{
+    StreamSink sink(stream);
+
+    writeTo(sink, file);
 
     return true;
 }
 
+template <typename Callback>
+static inline void forEachWritten(const PolicyFile &file,
+                                  const std::optional<std::vector<size_t>> &order,
+                                  Callback callback)
+{
+    if (!order) {
+        for (const auto &instruction : file.instructions) {
+            callback(instruction);
+        }
+        return;
+    }
+    for (auto index : *order) {
+        callback(file.instructions[index]);
+    }
+}
+
+std::optional<std::vector<size_t>> PRegParser::getWriteOrder(const PolicyFile &file)
+{
+    if (!m_writeOptions.canonical) {
+        return std::nullopt;
+    }
+    return canonicalOrder(file.instructions);
+}
+
+template <typename Sink>
+void PRegParser::writeFile(Sink &sink, const PolicyFile &file,
+                           const std::optional<std::vector<size_t>> &order)
+{
+    writeHeader(sink);
+    forEachWritten(file, order, [this, &sink](const PolicyInstruction &instruction) {
+        writeInstruction(sink, instruction);
+    });
+    sink.flush();
+}
+
+size_t PRegParser::getFileSize(const PolicyFile &file,
+                               const std::optional<std::vector<size_t>> &order)
+{
+    size_t size = sizeof(valid_header);
+
+    forEachWritten(file, order, [this, &size](const PolicyInstruction &instruction) {
+        size += getInstructionSize(instruction);
+    });
+
+    return size;
+}
+
+template <typename Sink>
+void PRegParser::writeTo(Sink &sink, const PolicyFile &file)
+{
+    writeFile(sink, file, getWriteOrder(file));
+}
+
+size_t PRegParser::serializedSize(const PolicyFile &file)
+{
+    return getFileSize(file, getWriteOrder(file));
+}
+
+size_t PRegParser::serializeInto(const PolicyFile &file, uint8_t *out, size_t capacity)
+{
+    auto order = getWriteOrder(file);
+
+    if (capacity < getFileSize(file, order)) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Output buffer is too small.");
+    }
+
+    BufferSink sink(out, capacity);
+
+    writeFile(sink, file, order);
+
+    return sink.written();
+}
+
+std::vector<uint8_t> PRegParser::serialize(const PolicyFile &file)
+{
+    // Order is computed once for both size and write.
+    auto order = getWriteOrder(file);
+    std::vector<uint8_t> result(getFileSize(file, order));
+    BufferSink sink(result.data(), result.size());
+
+    writeFile(sink, file, order);
+
+    return result;
+}
+
 PRegParser::~PRegParser()
 {
     ::iconv_close(this->m_iconvReadId);
     ::iconv_close(this->m_iconvWriteId);
 }
 
-void PRegParser::parseHeader(std::istream &stream)
+template <typename Source>
+void PRegParser::parseHeader(Source &source)
 {
     uint64_t header;
 
-    stream.read(reinterpret_cast<char*>(&header), 8);
-    check_stream(stream);
+    std::memcpy(&header, source.require(8), 8);
 
     if (header != valid_header) {
         throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
@@ -92,14 +523,16 @@ void PRegParser::parseHeader(std::istream &stream)
     }
 }
 
-uint32_t PRegParser::getSize(std::istream &stream)
+template <typename Source>
+uint32_t PRegParser::getSize(Source &source)
 {
-    return readIntegralFromBuffer<uint32_t, true>(stream);
+    return readIntegral<uint32_t, true>(source);
 }
 
-PolicyRegType PRegParser::getType(std::istream &stream)
+template <typename Source>
+PolicyRegType PRegParser::getType(Source &source)
 {
-    PolicyRegType type = static_cast<PolicyRegType>(readIntegralFromBuffer<uint32_t, true>(stream));
+    PolicyRegType type = static_cast<PolicyRegType>(readIntegral<uint32_t, true>(source));
 
     if (type >= PolicyRegType::REG_SZ && type <= PolicyRegType::REG_QWORD_BIG_ENDIAN) {
         return type;
@@ -108,103 +541,126 @@ PolicyRegType PRegParser::getType(std::istream &stream)
     return {};
 }
 
-std::string PRegParser::getKey(std::istream &stream)
+template <typename Source>
+std::string PRegParser::getKeypath(Source &source)
 {
-    std::string key;
-    char16_t data;
-
-    stream.read(reinterpret_cast<char *>(&data), 2);
-    check_stream(stream);
-
-    data = leToNative(data);
-
-    while (data >= 0x20 && data <= 0x7E && data != 0x5C) {
-        key.push_back(static_cast<char>(data));
-
-        stream.read(reinterpret_cast<char *>(&data), 2);
-        check_stream(stream);
+    std::string keyPath;
+    bool emptyKey = true;
+    char16_t sym = readSymbol(source);
+
+    while (sym != 0) {
+        // Keys are separated by `\`, every key must contain 1 or more symbols.
+        if (sym == 0x5C && !emptyKey) {
+            emptyKey = true;
+        } else if (sym >= 0x20 && sym <= 0x7E && sym != 0x5C) {
+            emptyKey = false;
+        } else {
+            throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                     + ", Unexpected symbol with code " + std::to_string(sym)
+                                     + ".");
+        }
+        keyPath.push_back(static_cast<char>(sym));
+        if (getEncodedSize(keyPath.size() * 2, 0, 0) > m_limits.maxInstructionSize) {
+            throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                     + ", Keypath exceeds instruction size limit.");
+        }
 
-        data = leToNative(data);
+        sym = readSymbol(source);
     }
 
-    // Key from Keypath must contain 1 or more symbols.
-    if (key.empty() || (data != 0 && data != 0x5C)) {
+    if (emptyKey) {
         throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
-                                 + ", Unexpected symbol with code " + std::to_string(data) + ".");
+                                 + ", Unexpected symbol with code " + std::to_string(sym) + ".");
     }
 
-    // Remove last symbol
-    stream.seekg(-2, std::ios::cur);
-
-    return { key };
+    return keyPath;
 }
 
-std::string PRegParser::getKeypath(std::istream &stream)
+template <typename Source>
+std::string PRegParser::getValue(Source &source)
 {
-    std::string keyPath;
-    char16_t sym = 0;
+    std::string result;
+    char16_t sym = readSymbol(source);
 
-    while (true) {
-        auto key = getKey(stream);
+    while (sym != 0) {
+        // Check maximum value length
+        if (sym < 0x20 || sym > 0x7E || result.length() == 259) {
+            throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                     + ", Unexpected symbol with code " + std::to_string(sym)
+                                     + ".");
+        }
+        result.push_back(static_cast<char>(sym));
 
-        keyPath.append(key);
+        sym = readSymbol(source);
+    }
 
-        stream.read(reinterpret_cast<char *>(&sym), 2);
-        check_stream(stream);
+    return result;
+}
 
-        // End of Keypath
-        if (sym == 0) {
-            break;
-        }
+template <typename Source>
+PolicyData PRegParser::getData(Source &source, PolicyRegType type, uint32_t size)
+{
+    // Data is decoded in place from the source block, without intermediate copy. Elements of
+    // string list are accounted once their bytes are read, before they are allocated.
+    auto data = source.require(size);
+    chargeMemory(m_limits, m_usage, getStringsOverhead(type, data, size));
+    return getData(data, type, size);
+}
 
-        // This if never be executed, but for safety i use it
-        if (sym != 0x5C) {
+std::string PRegParser::getKeypath(const uint8_t *data, size_t size)
+{
+    std::string keyPath(size / 2, '\0');
+    bool emptyKey = true;
+
+    for (size_t i = 0; i < keyPath.size(); ++i) {
+        char16_t sym = readIntegralFromMemory<uint16_t>(data + i * 2);
+
+        // Keys are separated by `\`, every key must contain 1 or more symbols.
+        if (sym == 0x5C && !emptyKey) {
+            emptyKey = true;
+        } else if (sym >= 0x20 && sym <= 0x7E && sym != 0x5C) {
+            emptyKey = false;
+        } else {
             throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
                                      + ", Unexpected symbol with code " + std::to_string(sym)
                                      + ".");
         }
+        keyPath[i] = static_cast<char>(sym);
+    }
 
-        keyPath.push_back('\\');
+    if (emptyKey) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Keypath is empty.");
     }
 
-    return { keyPath };
+    return keyPath;
 }
 
-std::string PRegParser::getValue(std::istream &stream)
+std::string PRegParser::getValue(const uint8_t *data, size_t size)
 {
-    std::string result;
-    char16_t data;
+    std::string result(size / 2, '\0');
 
-    stream.read(reinterpret_cast<char *>(&data), 2);
-    check_stream(stream);
-    data = leToNative(data);
+    // Check maximum value length
+    if (result.size() > 259) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Value is too long.");
+    }
 
-    // Key in specs [\x20-\x5B\x5D-\x7E](exclude '\'), when keypath include '\' like delimeter
-    while (data >= 0x20 && data <= 0x7E) {
-        // Key from Keypath must contain 1 or more symbols.
+    for (size_t i = 0; i < result.size(); ++i) {
+        char16_t sym = readIntegralFromMemory<uint16_t>(data + i * 2);
 
-        // Check maximum value length
-        if (result.length() == 259) {
+        if (sym < 0x20 || sym > 0x7E) {
             throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
-                                     + ", Unexpected symbol with code " + std::to_string(data)
+                                     + ", Unexpected symbol with code " + std::to_string(sym)
                                      + ".");
         }
-
-        result.push_back(data);
-
-        stream.read(reinterpret_cast<char *>(&data), 2);
-        check_stream(stream);
-        data = leToNative(data);
+        result[i] = static_cast<char>(sym);
     }
 
-    if (data != 0 || result.empty()) {
-        return {};
-    }
-
-    return { result };
+    return result;
 }
 
-PolicyData PRegParser::getData(std::istream &stream, PolicyRegType type, uint32_t size)
+PolicyData PRegParser::getData(const uint8_t *data, PolicyRegType type, uint32_t size)
 {
     switch (type) {
     case PolicyRegType::REG_NONE:
@@ -213,59 +669,88 @@ PolicyData PRegParser::getData(std::istream &stream, PolicyRegType type, uint32_
     case PolicyRegType::REG_SZ:
     case PolicyRegType::REG_EXPAND_SZ:
     case PolicyRegType::REG_LINK:
-        return { readStringFromBuffer(stream, size, this->m_iconvReadId) };
+        return { readStringFromMemory(data, size, this->m_iconvReadId) };
 
     case PolicyRegType::REG_BINARY:
-        return { readVectorFromBuffer(stream, size) };
+        return { std::vector<uint8_t>(data, data + size) };
 
     case PolicyRegType::REG_DWORD_LITTLE_ENDIAN:
-        return { readIntegralFromBuffer<uint32_t, true>(stream) };
     case PolicyRegType::REG_DWORD_BIG_ENDIAN:
-        return { readIntegralFromBuffer<uint32_t, false>(stream) };
+    case PolicyRegType::REG_QWORD_LITTLE_ENDIAN:
+    case PolicyRegType::REG_QWORD_BIG_ENDIAN:
+        return getIntegralData(data, type, size);
 
     case PolicyRegType::REG_MULTI_SZ:
     case PolicyRegType::REG_RESOURCE_LIST:
     case PolicyRegType::REG_FULL_RESOURCE_DESCRIPTOR: // ????
     case PolicyRegType::REG_RESOURCE_REQUIREMENTS_LIST:
-        return { readStringsFromBuffer(stream, size, this->m_iconvReadId) };
-
-    case PolicyRegType::REG_QWORD_LITTLE_ENDIAN:
-        return { readIntegralFromBuffer<uint64_t, true>(stream) };
-    case PolicyRegType::REG_QWORD_BIG_ENDIAN:
-        return { readIntegralFromBuffer<uint64_t, false>(stream) };
-        break;
+        return { readStringsFromMemory(data, size, this->m_iconvReadId) };
     }
     return {};
 }
 
-void PRegParser::insertInstruction(std::istream &stream, PolicyTree &tree)
+void PRegParser::materializeData(const uint8_t *data, const PolicyInstructionBounds &bounds,
+                                 PolicyInstruction &instruction)
+{
+    try {
+        validateType(bounds.type);
+
+        instruction.type = bounds.type;
+        instruction.data = getData(data + bounds.dataOffset, bounds.type, bounds.size);
+    } catch (const std::exception &e) {
+        throw std::runtime_error(std::string(e.what()) + "\nLINE: " + std::to_string(__LINE__)
+                                 + ", FILE: " + __FILE__
+                                 + ", Error was encountered wile parsing instruction with key: "
+                                 + instruction.key + ", value: " + instruction.value);
+    }
+}
+
+template <typename Source>
+void PRegParser::insertInstruction(Source &source, PolicyTree &tree,
+                                   const PolicyFilter &filter)
 {
     PolicyInstruction instruction;
     uint32_t dataSize;
 
-    check_sym(stream, '[');
+    check_sym(source, '[');
 
-    instruction.key = getKeypath(stream);
+    instruction.key = getKeypath(source);
 
-    check_sym(stream, ';');
+    check_sym(source, ';');
 
-    instruction.value = getValue(stream);
+    instruction.value = getValue(source);
 
     try {
-        check_sym(stream, ';');
+        check_sym(source, ';');
+
+        instruction.type = getType(source);
 
-        instruction.type = getType(stream);
+        check_sym(source, ';');
 
-        check_sym(stream, ';');
+        dataSize = getSize(source);
 
-        dataSize = getSize(stream);
+        check_sym(source, ';');
 
-        check_sym(stream, ';');
+        // Data is not allocated until declared size fits the limits.
+        checkLimits(m_limits, m_usage,
+                    getEncodedSize(instruction.key.size() * 2, instruction.value.size() * 2,
+                                   dataSize),
+                    getDecodedSize(instruction.key.size() * 2, instruction.value.size() * 2,
+                                   instruction.type, dataSize));
+
+        if (filter && !filter(instruction.key, instruction.value)) {
+            validateType(instruction.type);
+            source.skip(dataSize);
+            check_sym(source, ']');
+            return;
+        }
 
-        instruction.data = getData(stream, instruction.type, dataSize);
+        instruction.data = getData(source, instruction.type, dataSize);
 
-        check_sym(stream, ']');
+        check_sym(source, ']');
 
+        // Instruction is hashed while it is still hot in cache.
+        recordInstruction(instruction);
         tree.emplace_back(std::move(instruction));
 
     } catch (const std::exception &e) {
@@ -276,41 +761,102 @@ void PRegParser::insertInstruction(std::istream &stream, PolicyTree &tree)
     }
 }
 
-std::stringstream PRegParser::getDataStream(const PolicyData &data, PolicyRegType type)
+template <typename Source>
+void PRegParser::insertInstructionInfo(Source &source, uint64_t base,
+                                       std::vector<PolicyInstructionInfo> &infos)
 {
-    std::stringstream stream;
+    PolicyInstructionInfo info;
 
+    info.offset = base + source.position();
+
+    check_sym(source, '[');
+
+    info.key = getKeypath(source);
+
+    check_sym(source, ';');
+
+    info.value = getValue(source);
+
+    try {
+        check_sym(source, ';');
+
+        info.type = getType(source);
+        validateType(info.type);
+
+        check_sym(source, ';');
+
+        info.size = getSize(source);
+
+        check_sym(source, ';');
+
+        checkLimits(m_limits, m_usage,
+                    getEncodedSize(info.key.size() * 2, info.value.size() * 2, info.size),
+                    sizeof(PolicyInstructionInfo) + info.key.size() + info.value.size());
+
+        info.dataOffset = base + source.position();
+        source.skip(info.size);
+
+        check_sym(source, ']');
+
+        infos.emplace_back(std::move(info));
+
+    } catch (const std::exception &e) {
+        throw std::runtime_error(std::string(e.what()) + "\nLINE: " + std::to_string(__LINE__)
+                                 + ", FILE: " + __FILE__
+                                 + ", Error was encountered while scanning instruction with key: "
+                                 + info.key + ", value: " + info.value);
+    }
+}
+
+/*!
+ * \brief Alternative of data expected by its type, throws an std::runtime_error if it is not held
+ */
+template <typename T>
+static inline const T &getExpected(const PolicyData &data, PolicyRegType type)
+{
+    if (auto result = std::get_if<T>(&data)) {
+        return *result;
+    }
+    throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                             + ", Data does not match type "
+                             + std::to_string(static_cast<size_t>(type)) + ".");
+}
+
+uint32_t PRegParser::getDataSize(const PolicyData &data, PolicyRegType type)
+{
+    size_t size = 0;
+
+    // Sizes of strings are computed with validation of UTF-8, so data is known to be encodable.
     switch (type) {
     case PolicyRegType::REG_SZ:
     case PolicyRegType::REG_EXPAND_SZ:
     case PolicyRegType::REG_LINK:
-        writeStringToBuffer(stream, std::get<std::string>(data), this->m_iconvWriteId);
+        size = getStringDataSize(getExpected<std::string>(data, type));
         break;
 
     case PolicyRegType::REG_BINARY:
-        writeVectorToBuffer(stream, std::get<std::vector<uint8_t>>(data));
+        size = getExpected<std::vector<uint8_t>>(data, type).size();
         break;
 
     case PolicyRegType::REG_DWORD_LITTLE_ENDIAN:
-        writeIntegralToBuffer<uint32_t, true>(stream, std::get<uint32_t>(data));
-        break;
     case PolicyRegType::REG_DWORD_BIG_ENDIAN:
-        writeIntegralToBuffer<uint32_t, false>(stream, std::get<uint32_t>(data));
+        getExpected<uint32_t>(data, type);
+        size = sizeof(uint32_t);
         break;
 
     case PolicyRegType::REG_MULTI_SZ:
     case PolicyRegType::REG_RESOURCE_LIST:
     case PolicyRegType::REG_FULL_RESOURCE_DESCRIPTOR: // ????
     case PolicyRegType::REG_RESOURCE_REQUIREMENTS_LIST:
-        writeStringsFromBuffer(stream, std::get<std::vector<std::string>>(data),
-                               this->m_iconvWriteId);
+        for (const auto &str : getExpected<std::vector<std::string>>(data, type)) {
+            size += getStringDataSize(str);
+        }
         break;
 
     case PolicyRegType::REG_QWORD_LITTLE_ENDIAN:
-        writeIntegralToBuffer<uint64_t, true>(stream, std::get<uint64_t>(data));
-        break;
     case PolicyRegType::REG_QWORD_BIG_ENDIAN:
-        writeIntegralToBuffer<uint64_t, false>(stream, std::get<uint64_t>(data));
+        getExpected<uint64_t>(data, type);
+        size = sizeof(uint64_t);
         break;
 
     case PolicyRegType::REG_NONE:
@@ -322,61 +868,79 @@ std::stringstream PRegParser::getDataStream(const PolicyData &data, PolicyRegTyp
                                  + std::to_string(static_cast<size_t>(type)) + ".");
     }
 
-    return stream;
-}
+    if (size > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Data is too large.");
+    }
 
-void PRegParser::writeHeader(std::ostream &stream)
-{
-    stream.write(reinterpret_cast<const char*>(&valid_header), sizeof(valid_header));
+    return static_cast<uint32_t>(size);
 }
 
-void PRegParser::validateKey(std::string::const_iterator &begin, std::string::const_iterator &end)
+size_t PRegParser::getInstructionSize(const PolicyInstruction &instruction)
 {
-    auto cursor = begin;
-
-    while (cursor != end && *cursor >= 0x20 && *cursor <= 0x7E && *cursor != 0x5C) {
-        ++cursor;
+    if (isRawValid(instruction)) {
+        return instruction.raw.size;
     }
 
-    if (cursor == begin) {
-        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
-                                 + ", Key is empty.");
-    }
-    begin = cursor;
+    // `[`, four `;`, `]`, type and size fields
+    size_t size = 6 * sizeof(char16_t) + 2 * sizeof(uint32_t);
+
+    size += getStringDataSize(instruction.key);
+    size += getStringDataSize(instruction.value);
+    size += getDataSize(instruction.data, instruction.type);
+
+    return size;
 }
 
-void PRegParser::validateKeypath(std::string::const_iterator begin, std::string::const_iterator end)
+template <typename Sink>
+void PRegParser::writeData(Sink &sink, const PolicyData &data, PolicyRegType type)
 {
-    if (begin == end) {
-        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
-                                 + ", Keypath is empty.");
-    }
-    while (begin != end) {
-        validateKey(begin, end);
+    switch (type) {
+    case PolicyRegType::REG_SZ:
+    case PolicyRegType::REG_EXPAND_SZ:
+    case PolicyRegType::REG_LINK:
+        writeStringToSink(sink, std::get<std::string>(data), this->m_iconvWriteId);
+        break;
 
-        if (begin != end && *begin != 0x5C) {
-            throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
-                                     + ", Invalid character in key was encountered.");
-        }
+    case PolicyRegType::REG_BINARY:
+        writeVectorToSink(sink, std::get<std::vector<uint8_t>>(data));
+        break;
 
-        // Skip 0x5C character
-        ++begin;
-    }
-}
-void PRegParser::validateValue(std::string::const_iterator begin, std::string::const_iterator end)
-{
-    if (begin == end) {
+    case PolicyRegType::REG_DWORD_LITTLE_ENDIAN:
+        writeIntegral<uint32_t, true>(sink, std::get<uint32_t>(data));
+        break;
+    case PolicyRegType::REG_DWORD_BIG_ENDIAN:
+        writeIntegral<uint32_t, false>(sink, std::get<uint32_t>(data));
+        break;
+
+    case PolicyRegType::REG_MULTI_SZ:
+    case PolicyRegType::REG_RESOURCE_LIST:
+    case PolicyRegType::REG_FULL_RESOURCE_DESCRIPTOR: // ????
+    case PolicyRegType::REG_RESOURCE_REQUIREMENTS_LIST:
+        writeStringsToSink(sink, std::get<std::vector<std::string>>(data), this->m_iconvWriteId);
+        break;
+
+    case PolicyRegType::REG_QWORD_LITTLE_ENDIAN:
+        writeIntegral<uint64_t, true>(sink, std::get<uint64_t>(data));
+        break;
+    case PolicyRegType::REG_QWORD_BIG_ENDIAN:
+        writeIntegral<uint64_t, false>(sink, std::get<uint64_t>(data));
+        break;
+
+    case PolicyRegType::REG_NONE:
         throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
-                                 + ", Value is empty.");
+                                 + ", Unexpected type REG_NONE.");
+    default:
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Unexpected type UNKNOWN("
+                                 + std::to_string(static_cast<size_t>(type)) + ".");
     }
+}
 
-    while (begin != end) {
-        if (*begin < 0x20 || *begin > 0x7E) {
-            throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
-                                     + ", Invalid character in value was encountered.");
-        }
-        ++begin;
-    }
+template <typename Sink>
+void PRegParser::writeHeader(Sink &sink)
+{
+    sink.write(reinterpret_cast<const uint8_t *>(&valid_header), sizeof(valid_header));
 }
 
 void PRegParser::validateType(PolicyRegType type)
@@ -405,42 +969,48 @@ void PRegParser::validateType(PolicyRegType type)
     }
 }
 
-void PRegParser::writeInstruction(std::ostream &stream, const PolicyInstruction &instruction,
-                                  std::string key, std::string value)
+template <typename Sink>
+void PRegParser::writeInstruction(Sink &sink, const PolicyInstruction &instruction)
 {
+    if (isRawValid(instruction)) {
+        sink.write(instruction.raw.data.get(), instruction.raw.size);
+        return;
+    }
 
     try {
+        // Everything that can fail is checked before the first byte is written, so failed
+        // instruction leaves nothing of itself in sink.
         validateType(instruction.type);
+        validateKeypath(instruction.key);
+        validateValue(instruction.value);
+        auto dataSize = getDataSize(instruction.data, instruction.type);
 
-        write_sym(stream, '[');
-
-        writeStringToBuffer(stream, key);
+        write_sym(sink, '[');
 
-        write_sym(stream, ';');
+        writeStringToSink(sink, instruction.key, this->m_iconvWriteId);
 
-        writeStringToBuffer(stream, value);
+        write_sym(sink, ';');
 
-        write_sym(stream, ';');
+        writeStringToSink(sink, instruction.value, this->m_iconvWriteId);
 
-        writeIntegralToBuffer<uint32_t, true>(stream, static_cast<uint32_t>(instruction.type));
+        write_sym(sink, ';');
 
-        write_sym(stream, ';');
+        writeIntegral<uint32_t, true>(sink, static_cast<uint32_t>(instruction.type));
 
-        auto dataStream = getDataStream(instruction.data, instruction.type);
+        write_sym(sink, ';');
 
-        writeIntegralToBuffer<uint32_t, true>(stream, static_cast<uint32_t>(dataStream.tellp()));
+        writeIntegral<uint32_t, true>(sink, dataSize);
 
-        write_sym(stream, ';');
+        write_sym(sink, ';');
 
-        stream << dataStream.str();
-        check_stream(stream);
+        writeData(sink, instruction.data, instruction.type);
 
-        write_sym(stream, ']');
+        write_sym(sink, ']');
     } catch (const std::exception &e) {
         throw std::runtime_error(std::string(e.what()) + "\nLINE: " + std::to_string(__LINE__)
                                  + ", FILE: " + __FILE__
                                  + ", Error was encountered while writing instruction with key: "
-                                 + key + ", value: " + value);
+                                 + instruction.key + ", value: " + instruction.value);
     }
 }
 
@@ -449,4 +1019,18 @@ std::unique_ptr<PRegParser> createPregParser()
     return std::make_unique<PRegParser>();
 }
 
+// Parse and write cores are instantiated for every source and sink declared in source.h and
+// sink.h.
+template PolicyFile PRegParser::parseFrom(BufferSource &, const PolicyFilter &);
+template PolicyFile PRegParser::parseFrom(MmapSource &, const PolicyFilter &);
+template PolicyFile PRegParser::parseFrom(StreamSource &, const PolicyFilter &);
+template PolicyFile PRegParser::parseFrom(FdSource &, const PolicyFilter &);
+
+template void PRegParser::writeTo(BufferSink &, const PolicyFile &);
+template void PRegParser::writeTo(VectorSink &, const PolicyFile &);
+template void PRegParser::writeTo(StreamSink &, const PolicyFile &);
+template void PRegParser::writeTo(FdSink &, const PolicyFile &);
+template void PRegParser::writeTo(StreamOutput &, const PolicyFile &);
+template void PRegParser::writeTo(FdOutput &, const PolicyFile &);
+
 } // namespace pol
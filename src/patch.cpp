@@ -0,0 +1,219 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <unordered_map>
+
+#include <hash.h>
+#include <patch.h>
+
+namespace pol {
+
+/*!
+ * \brief Patch signature `PPAT`, LE
+ */
+static const uint32_t patch_magic = 0x54415050;
+static const uint32_t patch_version = 1;
+static const size_t header_size = 8;
+
+enum class PatchOperation : uint8_t {
+    Copy = 0,
+    Literal = 1,
+};
+
+static inline size_t getEnd(const PolicyInstructionBounds &bounds)
+{
+    return bounds.dataOffset + bounds.size + 2;
+}
+
+static inline bool equalInstructions(const uint8_t *lhsData, const PolicyInstructionBounds &lhs,
+                                     const uint8_t *rhsData, const PolicyInstructionBounds &rhs)
+{
+    auto size = getEnd(lhs) - lhs.offset;
+    return size == getEnd(rhs) - rhs.offset
+            && memcmp(lhsData + lhs.offset, rhsData + rhs.offset, size) == 0;
+}
+
+namespace {
+
+/*!
+ * \brief Collects operations, merging adjacent copies and literals
+ */
+class PatchBuilder final
+{
+public:
+    void add(PatchOperation kind, size_t offset, size_t size)
+    {
+        if (!m_operations.empty() && m_operations.back().kind == kind
+            && m_operations.back().offset + m_operations.back().size == offset) {
+            m_operations.back().size += size;
+            return;
+        }
+        m_operations.push_back({ kind, offset, size });
+    }
+
+    void write(VectorSink &sink, const uint8_t *target)
+    {
+        writeIntegral<uint64_t>(sink, m_operations.size());
+        for (const auto &operation : m_operations) {
+            writeIntegral<uint8_t>(sink, static_cast<uint8_t>(operation.kind));
+            if (operation.kind == PatchOperation::Copy) {
+                writeIntegral<uint64_t>(sink, operation.offset);
+            }
+            writeIntegral<uint64_t>(sink, operation.size);
+            if (operation.kind == PatchOperation::Literal) {
+                sink.write(target + operation.offset, operation.size);
+            }
+        }
+    }
+
+private:
+    typedef struct Operation
+    {
+        PatchOperation kind{};
+        /* Range of base for copy, range of target for literal */
+        size_t offset{};
+        size_t size{};
+    } Operation;
+
+    std::vector<Operation> m_operations{};
+};
+
+} // namespace
+
+std::vector<uint8_t> makePatch(const uint8_t *base, size_t baseSize, const uint8_t *target,
+                               size_t targetSize)
+{
+    auto baseBounds = scanInstructions(base, baseSize);
+    auto targetBounds = scanInstructions(target, targetSize);
+    std::unordered_map<uint64_t, size_t> index;
+    PatchBuilder builder;
+
+    // The first instruction with the same bytes is referenced, repeated ones are literals.
+    index.reserve(baseBounds.size());
+    for (size_t i = 0; i < baseBounds.size(); ++i) {
+        const auto &bounds = baseBounds[i];
+        index.try_emplace(hashBytes(base + bounds.offset, getEnd(bounds) - bounds.offset), i);
+    }
+
+    // Both headers are valid, so they are equal.
+    builder.add(PatchOperation::Copy, 0, header_size);
+
+    // Instruction following the previous match is tried first, so runs of unchanged
+    // instructions do not touch the index.
+    size_t next = 0;
+    for (const auto &bounds : targetBounds) {
+        auto size = getEnd(bounds) - bounds.offset;
+        auto found = baseBounds.size();
+
+        if (next < baseBounds.size()
+            && equalInstructions(base, baseBounds[next], target, bounds)) {
+            found = next;
+        } else {
+            auto indexed = index.find(hashBytes(target + bounds.offset, size));
+            if (indexed != index.end()
+                && equalInstructions(base, baseBounds[indexed->second], target, bounds)) {
+                found = indexed->second;
+            }
+        }
+
+        if (found == baseBounds.size()) {
+            builder.add(PatchOperation::Literal, bounds.offset, size);
+            continue;
+        }
+        builder.add(PatchOperation::Copy, baseBounds[found].offset, size);
+        next = found + 1;
+    }
+
+    std::vector<uint8_t> result;
+    VectorSink sink(result);
+
+    writeIntegral<uint32_t>(sink, patch_magic);
+    writeIntegral<uint32_t>(sink, patch_version);
+    writeIntegral<uint64_t>(sink, baseSize);
+    writeIntegral<uint64_t>(sink, hashBytes(base, baseSize));
+    writeIntegral<uint64_t>(sink, targetSize);
+    writeIntegral<uint64_t>(sink, hashBytes(target, targetSize));
+    builder.write(sink, target);
+
+    return result;
+}
+
+std::vector<uint8_t> applyPatch(const uint8_t *base, size_t baseSize, const uint8_t *patch,
+                                size_t patchSize)
+{
+    BufferSource source(patch, patchSize);
+
+    if (readIntegral<uint32_t>(source) != patch_magic) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Encountered with invalid patch signature.");
+    }
+    if (readIntegral<uint32_t>(source) != patch_version) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Encountered with unsupported patch version.");
+    }
+    if (readIntegral<uint64_t>(source) != baseSize
+        || readIntegral<uint64_t>(source) != hashBytes(base, baseSize)) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Patch is made for another base file.");
+    }
+
+    auto resultSize = readIntegral<uint64_t>(source);
+    auto resultHash = readIntegral<uint64_t>(source);
+    auto count = readIntegral<uint64_t>(source);
+    std::vector<uint8_t> result;
+
+    // Sizes are not trusted, every operation is checked against the rest of result.
+    result.reserve(std::min<uint64_t>(resultSize, baseSize + patchSize));
+    for (uint64_t i = 0; i < count; ++i) {
+        auto kind = readIntegral<uint8_t>(source);
+        uint64_t offset = 0;
+
+        if (kind == static_cast<uint8_t>(PatchOperation::Copy)) {
+            offset = readIntegral<uint64_t>(source);
+        } else if (kind != static_cast<uint8_t>(PatchOperation::Literal)) {
+            throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                     + ", Encountered with unknown patch operation "
+                                     + std::to_string(kind) + ".");
+        }
+
+        auto size = readIntegral<uint64_t>(source);
+        if (size > resultSize - result.size()
+            || (kind == static_cast<uint8_t>(PatchOperation::Copy)
+                && (offset > baseSize || size > baseSize - offset))) {
+            throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                     + ", Patch operation is out of range.");
+        }
+
+        const uint8_t *data = kind == static_cast<uint8_t>(PatchOperation::Copy)
+                ? base + offset
+                : source.require(static_cast<size_t>(size));
+        result.insert(result.end(), data, data + size);
+    }
+
+    if (!source.eof() || result.size() != resultSize
+        || hashBytes(result.data(), result.size()) != resultHash) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Patch result does not match its digest.");
+    }
+
+    return result;
+}
+
+} // namespace pol
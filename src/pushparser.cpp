@@ -0,0 +1,128 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <stdexcept>
+
+#include <pushparser.h>
+
+namespace pol {
+
+PRegPushParser::PRegPushParser(Callback callback, const ParseLimits &limits)
+    : m_callback(std::move(callback)), m_parser(createPregParser()), m_limits(limits)
+{
+}
+
+void PRegPushParser::feed(const uint8_t *data, size_t size)
+{
+    // Complete instructions are parsed straight from the chunk, only the tail is kept.
+    if (m_pending.empty()) {
+        auto consumed = consume(data, size);
+        m_pending.assign(data + consumed, data + size);
+    } else {
+        auto scanned = m_pending.size();
+        m_pending.insert(m_pending.end(), data, data + size);
+        if (!isWaiting(scanned)) {
+            auto consumed = consume(m_pending.data(), m_pending.size());
+            m_pending.erase(m_pending.begin(), m_pending.begin() + consumed);
+        }
+    }
+
+    // Pending bytes are a prefix of one instruction, do not wait for the rest of instruction
+    // which is already too large, or is known to be.
+    if (m_header && std::max(m_pending.size(), m_needed) > m_limits.maxInstructionSize) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Instruction exceeds size limit.");
+    }
+}
+
+void PRegPushParser::finish()
+{
+    if (!m_header || !m_pending.empty()) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Failed to read buffer, EOF was encountered.");
+    }
+}
+
+bool PRegPushParser::isWaiting(size_t scanned) const
+{
+    if (m_needed != 0) {
+        return m_pending.size() < m_needed;
+    }
+
+    // Keypath or value is incomplete, nothing changes until `\0` code unit arrives. Units are
+    // counted from the beginning of instruction.
+    for (size_t i = scanned & ~static_cast<size_t>(1); i + 1 < m_pending.size(); i += 2) {
+        if (m_pending[i] == 0 && m_pending[i + 1] == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void PRegPushParser::expect(const uint8_t *data, size_t size,
+                            const PolicyInstructionBounds &bounds)
+{
+    if (bounds.dataOffset != 0) {
+        m_needed = bounds.dataOffset + bounds.size + 2 - bounds.offset;
+        return;
+    }
+
+    // Size of data is not read yet. Value ends with the second `\0` code unit, fields after it
+    // take 16 bytes: `\0`, `;`, type, `;`, size and `;`. Before that, next `\0` is awaited.
+    const auto *begin = data + bounds.offset;
+    size_t length = size - bounds.offset;
+    size_t terminators = 0;
+
+    m_needed = 0;
+    for (size_t i = 2; i + 1 < length; i += 2) {
+        if (begin[i] == 0 && begin[i + 1] == 0 && ++terminators == 2) {
+            m_needed = i + 16;
+            return;
+        }
+    }
+}
+
+size_t PRegPushParser::consume(const uint8_t *data, size_t size)
+{
+    size_t offset = 0;
+
+    if (!m_header) {
+        if (!scanHeader(data, size)) {
+            m_needed = sizeof(uint64_t);
+            return 0;
+        }
+        m_header = true;
+        offset = sizeof(uint64_t);
+    }
+
+    PolicyInstructionBounds bounds;
+    while (offset < size && scanInstruction(data, size, offset, bounds)) {
+        checkLimits(m_limits, m_usage, data, bounds);
+        m_callback(m_parser->materialize(data, bounds));
+        offset = bounds.dataOffset + bounds.size + 2;
+    }
+    if (offset < size) {
+        expect(data, size, bounds);
+    }
+
+    return offset;
+}
+
+} // namespace pol
@@ -0,0 +1,221 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdexcept>
+
+#include <casefold.h>
+#include <common.h>
+#include <registry.h>
+
+namespace pol {
+
+static const std::string_view deletePrefix = "**del.";
+static const std::string_view deleteAllValues = "**delvals.";
+static const std::string_view deleteValues = "**deletevalues";
+static const std::string_view deleteKeys = "**deletekeys";
+static const std::string_view secureKey = "**securekey";
+static const std::string_view softPrefix = "**soft.";
+
+static inline bool startsWith(std::string_view source, std::string_view prefix)
+{
+    return source.size() >= prefix.size() && source.substr(0, prefix.size()) == prefix;
+}
+
+/*!
+ * \brief Get `;` separated list from REG_SZ data of special value
+ */
+static const std::string &getListData(const PolicyInstruction &instruction)
+{
+    auto data = std::get_if<std::string>(&instruction.data);
+    if (data == nullptr) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Expected REG_SZ data for value " + instruction.value
+                                 + " of key " + instruction.key + ".");
+    }
+    return *data;
+}
+
+template <typename Callback>
+static inline void forEachToken(std::string_view source, char delimiter, Callback callback)
+{
+    while (!source.empty()) {
+        auto found = source.find(delimiter);
+        auto token = source.substr(0, found);
+
+        if (!token.empty()) {
+            callback(token);
+        }
+        if (found == std::string_view::npos) {
+            break;
+        }
+        source.remove_prefix(found + 1);
+    }
+}
+
+/*!
+ * \brief Walk down from `from` by `\` separated keypath. Return nullptr if any key is absent.
+ */
+static RegistryKey *findSubkey(const RegistryKey &from, std::string_view keypath)
+{
+    const RegistryKey *current = &from;
+
+    forEachToken(keypath, '\\', [&current](std::string_view name) {
+        if (current == nullptr) {
+            return;
+        }
+        auto found = current->subkeys.find(foldCase(name));
+        current = found == current->subkeys.end() ? nullptr : found->second.get();
+    });
+
+    return const_cast<RegistryKey *>(current);
+}
+
+void RegistryModel::apply(const PolicyFile &file)
+{
+    for (const auto &instruction : file.instructions) {
+        apply(instruction);
+    }
+}
+
+void RegistryModel::apply(const PolicyInstruction &instruction)
+{
+    auto value = foldCase(instruction.value);
+
+    if (value.empty()) {
+        createKey(instruction.key);
+    } else if (value == deleteAllValues) {
+        if (auto key = lookupKey(instruction.key)) {
+            key->values.clear();
+        }
+    } else if (startsWith(value, deletePrefix)) {
+        if (auto key = lookupKey(instruction.key)) {
+            key->values.erase(value.substr(deletePrefix.size()));
+        }
+    } else if (value == deleteValues) {
+        if (auto key = lookupKey(instruction.key)) {
+            forEachToken(getListData(instruction), ';',
+                         [key](std::string_view name) { key->values.erase(foldCase(name)); });
+        }
+    } else if (value == deleteKeys) {
+        if (auto key = lookupKey(instruction.key)) {
+            forEachToken(getListData(instruction), ';',
+                         [this, key](std::string_view name) { deleteKey(*key, name); });
+        }
+    } else if (value == secureKey) {
+        auto data = std::get_if<uint32_t>(&instruction.data);
+        if (data == nullptr) {
+            throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                     + ", Expected DWORD data for value " + instruction.value
+                                     + " of key " + instruction.key + ".");
+        }
+        createKey(instruction.key).secure = *data != 0;
+    } else if (startsWith(value, softPrefix)) {
+        setValue(createKey(instruction.key),
+                 std::string_view(instruction.value).substr(softPrefix.size()), instruction, true);
+    } else {
+        setValue(createKey(instruction.key), instruction.value, instruction, false);
+    }
+}
+
+RegistryKey::~RegistryKey()
+{
+    releaseSubtrees(subkeys, &RegistryKey::subkeys);
+}
+
+void RegistryModel::clear()
+{
+    releaseSubtrees(m_root.subkeys, &RegistryKey::subkeys);
+    m_root.values.clear();
+    m_root.secure = false;
+}
+
+const RegistryKey &RegistryModel::root() const
+{
+    return m_root;
+}
+
+const RegistryKey *RegistryModel::findKey(std::string_view keypath) const
+{
+    return lookupKey(keypath);
+}
+
+const RegistryValue *RegistryModel::findValue(std::string_view keypath,
+                                              std::string_view value) const
+{
+    auto key = lookupKey(keypath);
+    if (key == nullptr) {
+        return nullptr;
+    }
+
+    auto found = key->values.find(foldCase(value));
+    return found == key->values.end() ? nullptr : &found->second;
+}
+
+RegistryKey &RegistryModel::createKey(std::string_view keypath)
+{
+    RegistryKey *current = &m_root;
+
+    forEachToken(keypath, '\\', [&current](std::string_view name) {
+        auto &child = current->subkeys[foldCase(name)];
+        if (!child) {
+            child = std::make_unique<RegistryKey>();
+            child->name = std::string(name);
+        }
+        current = child.get();
+    });
+
+    return *current;
+}
+
+RegistryKey *RegistryModel::lookupKey(std::string_view keypath) const
+{
+    return findSubkey(m_root, keypath);
+}
+
+void RegistryModel::deleteKey(RegistryKey &parent, std::string_view keypath)
+{
+    RegistryKey *owner = &parent;
+    auto separator = keypath.rfind('\\');
+
+    // Nested subkey, like `A\B`, is removed from its direct parent.
+    if (separator != std::string_view::npos) {
+        owner = findSubkey(parent, keypath.substr(0, separator));
+        keypath.remove_prefix(separator + 1);
+    }
+
+    if (owner != nullptr) {
+        owner->subkeys.erase(foldCase(keypath));
+    }
+}
+
+void RegistryModel::setValue(RegistryKey &key, std::string_view name,
+                             const PolicyInstruction &instruction, bool soft)
+{
+    auto &value = key.values[foldCase(name)];
+
+    if (soft && !value.name.empty()) {
+        return;
+    }
+
+    value.name = std::string(name);
+    value.type = instruction.type;
+    value.data = instruction.data;
+}
+
+} // namespace pol
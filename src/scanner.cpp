@@ -0,0 +1,168 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdexcept>
+#include <string>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+#include <binary.h>
+#include <parser.h>
+
+namespace pol {
+
+static const uint8_t valid_header[8] = { 0x50, 0x52, 0x65, 0x67, 0x01, 0x00, 0x00, 0x00 };
+
+/*!
+ * \brief Find UTF-16LE '\0' in [begin, end), return nullptr if there is no one.
+ * With SSE2 eight code units are checked at once.
+ */
+static inline const uint8_t *findTerminator(const uint8_t *begin, const uint8_t *end)
+{
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+
+    while (end - begin >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(chunk, zero));
+        if (mask != 0) {
+            return begin + __builtin_ctz(mask);
+        }
+        begin += 16;
+    }
+#endif
+    for (; end - begin >= 2; begin += 2) {
+        if (begin[0] == 0 && begin[1] == 0) {
+            return begin;
+        }
+    }
+
+    return nullptr;
+}
+
+/*!
+ * \brief Check UTF-16LE symbol at `data`
+ */
+static inline void checkSymbol(const uint8_t *data, char16_t sym)
+{
+    if (data[0] != static_cast<uint8_t>(sym) || data[1] != 0) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Failed to read buffer, invalid symbol was encountered.");
+    }
+}
+
+bool scanInstruction(const uint8_t *data, size_t size, size_t offset,
+                     PolicyInstructionBounds &bounds)
+{
+    const uint8_t *end = data + size;
+    const uint8_t *cursor = data + offset;
+
+    bounds.offset = offset;
+    bounds.dataOffset = 0;
+
+    // `[` KeyPath '\0' `;`
+    if (end - cursor < 2) {
+        return false;
+    }
+    checkSymbol(cursor, '[');
+    cursor += 2;
+
+    auto terminator = findTerminator(cursor, end);
+    if (terminator == nullptr) {
+        return false;
+    }
+    bounds.keypathSize = static_cast<uint32_t>(terminator - cursor);
+    cursor = terminator + 2;
+
+    if (end - cursor < 2) {
+        return false;
+    }
+    checkSymbol(cursor, ';');
+    cursor += 2;
+
+    // Value '\0' `;` Type `;` Size `;`
+    terminator = findTerminator(cursor, end);
+    if (terminator == nullptr) {
+        return false;
+    }
+    bounds.valueOffset = cursor - data;
+    bounds.valueSize = static_cast<uint32_t>(terminator - cursor);
+    cursor = terminator + 2;
+
+    if (end - cursor < 14) {
+        return false;
+    }
+    checkSymbol(cursor, ';');
+    bounds.type = static_cast<PolicyRegType>(readIntegralFromMemory<uint32_t>(cursor + 2));
+    checkSymbol(cursor + 6, ';');
+    bounds.size = readIntegralFromMemory<uint32_t>(cursor + 8);
+    checkSymbol(cursor + 12, ';');
+    cursor += 14;
+
+    // Data `]`
+    bounds.dataOffset = cursor - data;
+    if (static_cast<size_t>(end - cursor) < static_cast<size_t>(bounds.size) + 2) {
+        return false;
+    }
+    cursor += bounds.size;
+    checkSymbol(cursor, ']');
+
+    return true;
+}
+
+bool scanHeader(const uint8_t *data, size_t size)
+{
+    if (size < sizeof(valid_header)) {
+        return false;
+    }
+    if (memcmp(data, valid_header, sizeof(valid_header)) != 0) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Encountered with invalid header.");
+    }
+    return true;
+}
+
+std::vector<PolicyInstructionBounds> scanInstructions(const uint8_t *data, size_t size)
+{
+    std::vector<PolicyInstructionBounds> result;
+    size_t offset = sizeof(valid_header);
+
+    if (!scanHeader(data, size)) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Encountered with invalid header.");
+    }
+
+    while (offset < size) {
+        PolicyInstructionBounds bounds;
+
+        if (!scanInstruction(data, size, offset, bounds)) {
+            throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                     + ", Failed to read buffer, EOF was encountered.");
+        }
+
+        offset = bounds.dataOffset + bounds.size + 2;
+        result.push_back(bounds);
+    }
+
+    return result;
+}
+
+} // namespace pol
@@ -0,0 +1,96 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <source.h>
+
+namespace pol {
+
+MmapSource::MmapSource(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Failed to open " + path + ": " + std::strerror(errno)
+                                 + ".");
+    }
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        auto error = errno;
+        ::close(fd);
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Failed to stat " + path + ": " + std::strerror(error)
+                                 + ".");
+    }
+
+    // Empty file can not be mapped, it is served as empty buffer.
+    if (info.st_size > 0) {
+        m_mappingSize = static_cast<size_t>(info.st_size);
+        m_mapping = ::mmap(nullptr, m_mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    auto error = errno;
+    ::close(fd);
+
+    if (m_mapping == MAP_FAILED) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Failed to map " + path + ": " + std::strerror(error)
+                                 + ".");
+    }
+
+    reset(static_cast<const uint8_t *>(m_mapping), m_mappingSize);
+}
+
+MmapSource::~MmapSource()
+{
+    if (m_mapping != nullptr) {
+        ::munmap(m_mapping, m_mappingSize);
+    }
+}
+
+size_t FdInput::read(uint8_t *data, size_t size)
+{
+    while (true) {
+        auto count = ::read(m_fd, data, size);
+        if (count >= 0) {
+            return static_cast<size_t>(count);
+        }
+        if (errno != EINTR) {
+            throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                     + ", Failed to read buffer: " + std::strerror(errno)
+                                     + ".");
+        }
+    }
+}
+
+void FdInput::unread(size_t size) noexcept
+{
+    // Pipes and sockets can not seek, read ahead data is lost then.
+    ::lseek(m_fd, -static_cast<off_t>(size), SEEK_CUR);
+}
+
+} // namespace pol
@@ -0,0 +1,269 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <stdexcept>
+
+#include <binary.h>
+#include <common.h>
+#include <writer.h>
+
+namespace pol {
+
+[[noreturn]] static void throwTypeMismatch(PolicyRegType type)
+{
+    throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                             + ", Data does not match type "
+                             + std::to_string(static_cast<size_t>(type)) + ".");
+}
+
+/*!
+ * \brief Put validated ASCII string as null-terminated UTF-16LE, without iconv
+ */
+template <typename Sink>
+static void writeAscii(Sink &sink, std::string_view data)
+{
+    std::array<uint16_t, 256> temp;
+
+    while (!data.empty()) {
+        auto count = std::min(data.size(), temp.size());
+
+        for (size_t i = 0; i < count; ++i) {
+            temp[i] = nativeToLe<uint16_t>(static_cast<uint8_t>(data[i]));
+        }
+        sink.write(reinterpret_cast<const uint8_t *>(temp.data()), count * sizeof(uint16_t));
+        data.remove_prefix(count);
+    }
+    writeSymbol(sink, 0);
+}
+
+template <typename Sink>
+PRegWriter<Sink>::PRegWriter(Sink &sink) : m_sink(sink)
+{
+    m_iconvWriteId = ::iconv_open("UTF-16LE", "UTF-8");
+    if (m_iconvWriteId == ICONV_ERROR_DESCRIPTOR) {
+        throw std::runtime_error(
+                "LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                + ", Encountered with the inability to create a iconv descriptor.");
+    }
+
+    m_sink.write(reinterpret_cast<const uint8_t *>(&valid_header), sizeof(valid_header));
+}
+
+template <typename Sink>
+PRegWriter<Sink>::~PRegWriter()
+{
+    ::iconv_close(m_iconvWriteId);
+}
+
+template <typename Sink>
+void PRegWriter<Sink>::add(const PolicyInstruction &instruction)
+{
+    // Unmodified parsed instruction is copied verbatim.
+    if (isRawValid(instruction)) {
+        m_sink.write(instruction.raw.data.get(), instruction.raw.size);
+        ++m_count;
+        return;
+    }
+
+    add(instruction.key, instruction.value, instruction.type, instruction.data);
+}
+
+template <typename Sink>
+void PRegWriter<Sink>::add(std::string_view keypath, std::string_view value, PolicyRegType type,
+                           const PolicyData &data)
+{
+    switch (type) {
+    case PolicyRegType::REG_SZ:
+    case PolicyRegType::REG_EXPAND_SZ:
+    case PolicyRegType::REG_LINK:
+        if (auto string = std::get_if<std::string>(&data)) {
+            return addString(keypath, value, type, *string);
+        }
+        break;
+
+    case PolicyRegType::REG_BINARY:
+        if (auto binary = std::get_if<std::vector<uint8_t>>(&data)) {
+            return addBinary(keypath, value, binary->data(), binary->size());
+        }
+        break;
+
+    case PolicyRegType::REG_DWORD_LITTLE_ENDIAN:
+    case PolicyRegType::REG_DWORD_BIG_ENDIAN:
+        if (auto number = std::get_if<uint32_t>(&data)) {
+            return addInteger(keypath, value, type, *number);
+        }
+        break;
+
+    case PolicyRegType::REG_QWORD_LITTLE_ENDIAN:
+    case PolicyRegType::REG_QWORD_BIG_ENDIAN:
+        if (auto number = std::get_if<uint64_t>(&data)) {
+            return addInteger(keypath, value, type, *number);
+        }
+        break;
+
+    case PolicyRegType::REG_MULTI_SZ:
+    case PolicyRegType::REG_RESOURCE_LIST:
+    case PolicyRegType::REG_FULL_RESOURCE_DESCRIPTOR:
+    case PolicyRegType::REG_RESOURCE_REQUIREMENTS_LIST:
+        if (auto strings = std::get_if<std::vector<std::string>>(&data)) {
+            return addStrings(keypath, value, type,
+                              std::vector<std::string_view>(strings->begin(), strings->end()));
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    throwTypeMismatch(type);
+}
+
+template <typename Sink>
+void PRegWriter<Sink>::addString(std::string_view keypath, std::string_view value,
+                                 PolicyRegType type, std::string_view data)
+{
+    if (type != PolicyRegType::REG_SZ && type != PolicyRegType::REG_EXPAND_SZ
+        && type != PolicyRegType::REG_LINK) {
+        throwTypeMismatch(type);
+    }
+
+    writePrefix(keypath, value, type, getStringDataSize(data));
+    writeStringToSink(m_sink, data, m_iconvWriteId);
+    writeSuffix();
+}
+
+template <typename Sink>
+void PRegWriter<Sink>::addStrings(std::string_view keypath, std::string_view value,
+                                  PolicyRegType type, const std::vector<std::string_view> &data)
+{
+    if (type != PolicyRegType::REG_MULTI_SZ && type != PolicyRegType::REG_RESOURCE_LIST
+        && type != PolicyRegType::REG_FULL_RESOURCE_DESCRIPTOR
+        && type != PolicyRegType::REG_RESOURCE_REQUIREMENTS_LIST) {
+        throwTypeMismatch(type);
+    }
+
+    size_t size = 0;
+    for (auto string : data) {
+        size += getStringDataSize(string);
+    }
+
+    writePrefix(keypath, value, type, size);
+    for (auto string : data) {
+        writeStringToSink(m_sink, string, m_iconvWriteId);
+    }
+    writeSuffix();
+}
+
+template <typename Sink>
+void PRegWriter<Sink>::addBinary(std::string_view keypath, std::string_view value,
+                                 const uint8_t *data, size_t size)
+{
+    writePrefix(keypath, value, PolicyRegType::REG_BINARY, size);
+    m_sink.write(data, size);
+    writeSuffix();
+}
+
+template <typename Sink>
+void PRegWriter<Sink>::addInteger(std::string_view keypath, std::string_view value,
+                                  PolicyRegType type, uint64_t data)
+{
+    switch (type) {
+    case PolicyRegType::REG_DWORD_LITTLE_ENDIAN:
+    case PolicyRegType::REG_DWORD_BIG_ENDIAN:
+        if (data > std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                     + ", DWORD data is too large.");
+        }
+
+        writePrefix(keypath, value, type, sizeof(uint32_t));
+        if (type == PolicyRegType::REG_DWORD_LITTLE_ENDIAN) {
+            writeIntegral<uint32_t, true>(m_sink, static_cast<uint32_t>(data));
+        } else {
+            writeIntegral<uint32_t, false>(m_sink, static_cast<uint32_t>(data));
+        }
+        break;
+
+    case PolicyRegType::REG_QWORD_LITTLE_ENDIAN:
+        writePrefix(keypath, value, type, sizeof(uint64_t));
+        writeIntegral<uint64_t, true>(m_sink, data);
+        break;
+    case PolicyRegType::REG_QWORD_BIG_ENDIAN:
+        writePrefix(keypath, value, type, sizeof(uint64_t));
+        writeIntegral<uint64_t, false>(m_sink, data);
+        break;
+
+    default:
+        throwTypeMismatch(type);
+    }
+
+    writeSuffix();
+}
+
+template <typename Sink>
+void PRegWriter<Sink>::flush()
+{
+    m_sink.flush();
+}
+
+template <typename Sink>
+size_t PRegWriter<Sink>::count() const
+{
+    return m_count;
+}
+
+template <typename Sink>
+void PRegWriter<Sink>::writePrefix(std::string_view keypath, std::string_view value,
+                                   PolicyRegType type, size_t size)
+{
+    validateKeypath(keypath);
+    validateValue(value);
+    if (size > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("LINE: " + std::to_string(__LINE__) + ", FILE: " + __FILE__
+                                 + ", Data is too large.");
+    }
+
+    write_sym(m_sink, '[');
+    writeAscii(m_sink, keypath);
+    write_sym(m_sink, ';');
+    writeAscii(m_sink, value);
+    write_sym(m_sink, ';');
+    writeIntegral<uint32_t, true>(m_sink, static_cast<uint32_t>(type));
+    write_sym(m_sink, ';');
+    writeIntegral<uint32_t, true>(m_sink, static_cast<uint32_t>(size));
+    write_sym(m_sink, ';');
+}
+
+template <typename Sink>
+void PRegWriter<Sink>::writeSuffix()
+{
+    write_sym(m_sink, ']');
+    ++m_count;
+}
+
+template class PRegWriter<BufferSink>;
+template class PRegWriter<VectorSink>;
+template class PRegWriter<StreamSink>;
+template class PRegWriter<FdSink>;
+template class PRegWriter<StreamOutput>;
+template class PRegWriter<FdOutput>;
+
+} // namespace pol
@@ -0,0 +1,261 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_TEST_BUFFER
+#define PREGPARSER_TEST_BUFFER
+
+#include <cassert>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <parallel.h>
+#include <parser.h>
+#include <pushparser.h>
+
+#include "./serialize.h"
+
+template <typename Callable>
+bool throwsRuntimeError(Callable callable)
+{
+    try {
+        callable();
+    } catch (const std::runtime_error &) {
+        return true;
+    }
+    return false;
+}
+
+/*!
+ * \brief Create file with unique name in temporary directory, holding `data`
+ */
+std::string makeTempFile(const std::vector<uint8_t> &data = {})
+{
+    auto path = (std::filesystem::temp_directory_path() / "parsepol-test-XXXXXX").string();
+    int fd = ::mkstemp(path.data());
+    assert(fd >= 0);
+
+    for (size_t offset = 0; offset < data.size();) {
+        auto written = ::write(fd, data.data() + offset, data.size() - offset);
+        assert(written > 0);
+        offset += static_cast<size_t>(written);
+    }
+    ::close(fd);
+
+    return path;
+}
+
+void testBufferParse()
+{
+    auto parser = pol::createPregParser();
+    auto file = makeSampleFile();
+    auto buffer = parser->serialize(file);
+
+    auto bounds = pol::scanInstructions(buffer.data(), buffer.size());
+    assert(bounds.size() == file.instructions.size());
+    assert(bounds[0].offset == 8 && bounds[5].size == 4);
+    assert(parser->parse(buffer.data(), buffer.size()) == file);
+    std::cout << "two-pass buffer parse: OK" << std::endl;
+
+    for (size_t size : { size_t(0), size_t(7), size_t(9), buffer.size() - 1 }) {
+        assert(throwsRuntimeError([&]() { parser->parse(buffer.data(), size); }));
+    }
+
+    auto corrupted = buffer;
+    corrupted[bounds[1].offset + 2] = 0x01;
+    assert(throwsRuntimeError([&]() { parser->parse(corrupted.data(), corrupted.size()); }));
+
+    corrupted = buffer;
+    corrupted[bounds[1].dataOffset + bounds[1].size] = ';';
+    assert(throwsRuntimeError([&]() { parser->parse(corrupted.data(), corrupted.size()); }));
+    std::cout << "two-pass buffer parse of malformed file: OK" << std::endl;
+}
+
+/*!
+ * \brief Sample file repeated `count` times with unique values
+ */
+pol::PolicyFile makeLargeFile(size_t count)
+{
+    auto sample = makeSampleFile();
+    pol::PolicyFile file;
+
+    for (size_t i = 0; i < count; ++i) {
+        for (auto instruction : sample.instructions) {
+            instruction.value += std::to_string(i);
+            file.instructions.push_back(std::move(instruction));
+        }
+    }
+
+    return file;
+}
+
+void testParallelParse()
+{
+    auto parser = pol::createPregParser();
+    auto file = makeLargeFile(1000);
+    auto buffer = parser->serialize(file);
+
+    assert(pol::parseParallel(buffer.data(), buffer.size(), 4) == file);
+    assert(pol::parseParallel(buffer.data(), buffer.size()) == file);
+
+    auto bounds = pol::scanInstructions(buffer.data(), buffer.size());
+    buffer[bounds[7777].valueOffset] = 0x01;
+    assert(throwsRuntimeError([&]() { pol::parseParallel(buffer.data(), buffer.size(), 4); }));
+    std::cout << "parallel buffer parse: OK" << std::endl;
+}
+
+void testParseMany()
+{
+    auto parser = pol::createPregParser();
+    auto file = makeSampleFile();
+    std::vector<std::vector<uint8_t>> buffers;
+
+    for (size_t i = 0; i < 64; ++i) {
+        buffers.push_back(parser->serialize(file));
+    }
+    buffers[13].pop_back();
+
+    pol::ParseManyOptions options;
+    options.threads = 4;
+    auto results = pol::parseMany(buffers, options);
+    assert(results.size() == buffers.size());
+    for (size_t i = 0; i < results.size(); ++i) {
+        assert(results[i].ok() == (i != 13));
+        assert(i == 13 ? !results[i].error.empty() : *results[i].file == file);
+    }
+
+    options.filter = pol::keypathPrefixFilter("Software\\Policies\\Sample\\Multi");
+    results = pol::parseMany(std::vector<std::string>{ "/nonexistent/Registry.pol" }, options);
+    assert(results.size() == 1 && !results[0].ok());
+    assert(pol::parseMany(buffers, options)[0].file->instructions.size() == 3);
+    std::cout << "parse many files: OK" << std::endl;
+}
+
+void testPushParser()
+{
+    auto parser = pol::createPregParser();
+    auto file = makeLargeFile(20);
+    auto buffer = parser->serialize(file);
+
+    for (size_t chunk : { size_t(1), size_t(3), size_t(64), size_t(4096), buffer.size() }) {
+        pol::PolicyFile result;
+        pol::PRegPushParser push([&result](pol::PolicyInstruction &&instruction) {
+            result.instructions.push_back(std::move(instruction));
+        });
+
+        for (size_t offset = 0; offset < buffer.size(); offset += chunk) {
+            push.feed(buffer.data() + offset, std::min(chunk, buffer.size() - offset));
+        }
+        push.finish();
+        assert(result == file);
+    }
+
+    // Large instruction fed by bytes is scanned again only when its names or data may be
+    // complete, and it is passed as soon as its last byte arrives.
+    pol::PolicyFile large;
+    large.instructions = { { pol::PolicyRegType::REG_BINARY, std::vector<uint8_t>(1 << 20, 0),
+                             "Software\\" + std::string(1 << 16, 'K'),
+                             std::string(259, 'V') } };
+    auto largeBuffer = parser->serialize(large);
+    size_t count = 0;
+    pol::PRegPushParser bytes([&count](pol::PolicyInstruction &&) { ++count; });
+    for (size_t offset = 0; offset + 1 < largeBuffer.size(); ++offset) {
+        bytes.feed(largeBuffer.data() + offset, 1);
+    }
+    assert(count == 0);
+    bytes.feed(&largeBuffer.back(), 1);
+    bytes.finish();
+    assert(count == 1);
+
+    pol::PRegPushParser truncated([](pol::PolicyInstruction &&) {});
+    truncated.feed(buffer.data(), buffer.size() - 1);
+    assert(throwsRuntimeError([&]() { truncated.finish(); }));
+    std::cout << "push parser over chunked input: OK" << std::endl;
+}
+
+/*!
+ * \brief Pipe-like stream buffer: hands out data in small pieces and can not seek.
+ */
+class NonSeekableBuffer final : public std::streambuf
+{
+public:
+    NonSeekableBuffer(const std::vector<uint8_t> &data, size_t piece)
+        : m_data(data)
+        , m_piece(piece)
+    {
+    }
+
+protected:
+    int_type underflow() override
+    {
+        if (m_offset == m_data.size()) {
+            return traits_type::eof();
+        }
+        auto begin = reinterpret_cast<char *>(m_data.data()) + m_offset;
+        m_offset += std::min(m_piece, m_data.size() - m_offset);
+        setg(begin, begin, reinterpret_cast<char *>(m_data.data()) + m_offset);
+        return traits_type::to_int_type(*begin);
+    }
+
+private:
+    std::vector<uint8_t> m_data;
+    size_t m_piece;
+    size_t m_offset{};
+};
+
+void testNonSeekableParse()
+{
+    auto parser = pol::createPregParser();
+    auto file = makeLargeFile(2000);
+    auto buffer = parser->serialize(file);
+
+    NonSeekableBuffer pipe(buffer, 1000);
+    std::istream pipeStream(&pipe);
+    assert(parser->parse(pipeStream) == file);
+
+    std::stringstream seekable;
+    seekable.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+    auto expected = parser->scanMetadata(seekable);
+
+    NonSeekableBuffer metadataPipe(buffer, 777);
+    std::istream metadataStream(&metadataPipe);
+    auto infos = parser->scanMetadata(metadataStream);
+    assert(infos.size() == expected.size());
+    for (size_t i = 0; i < infos.size(); ++i) {
+        assert(infos[i].offset == expected[i].offset);
+        assert(infos[i].dataOffset == expected[i].dataOffset);
+    }
+
+    // Read ahead bytes are returned to the stream, next instruction starts where it should.
+    seekable.clear();
+    seekable.seekg(8);
+    assert(parser->parseInstruction(seekable) == file.instructions[0]);
+    assert(parser->parseInstruction(seekable) == file.instructions[1]);
+
+    NonSeekableBuffer truncated({ buffer.begin(), buffer.end() - 1 }, 1000);
+    std::istream truncatedStream(&truncated);
+    assert(throwsRuntimeError([&]() { parser->parse(truncatedStream); }));
+    std::cout << "parse from non-seekable stream: OK" << std::endl;
+}
+
+#endif // PREGPARSER_TEST_BUFFER
@@ -0,0 +1,108 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_TEST_CANONICAL
+#define PREGPARSER_TEST_CANONICAL
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <random>
+
+#include <canonical.h>
+#include <parser.h>
+
+#include "./buffer.h"
+
+static std::string lowercase(std::string source)
+{
+    std::transform(source.begin(), source.end(), source.begin(),
+                   [](char sym) { return sym >= 'A' && sym <= 'Z' ? sym - 'A' + 'a' : sym; });
+    return source;
+}
+
+void testCanonicalOrder()
+{
+    auto parser = pol::createPregParser();
+    std::mt19937 random(7);
+    pol::PolicyFile file;
+
+    // Keys share long prefixes and differ by case, so every branch of sort is reached.
+    for (size_t i = 0; i < 20000; ++i) {
+        pol::PolicyInstruction instruction;
+        instruction.key = "Software\\Policies\\Vendor\\Product";
+        for (size_t depth = random() % 4; depth > 0; --depth) {
+            instruction.key += (random() % 2 ? "\\Sub" : "\\sub") + std::to_string(random() % 5);
+        }
+        instruction.value = (random() % 2 ? "Value" : "VALUE") + std::to_string(random() % 50);
+        instruction.type = pol::PolicyRegType::REG_DWORD_LITTLE_ENDIAN;
+        instruction.data = static_cast<uint32_t>(i);
+        file.instructions.push_back(std::move(instruction));
+    }
+
+    auto canonical = file;
+    pol::canonicalize(canonical);
+
+    // Every pair is kept once, with data of its last instruction.
+    auto expected = file.instructions;
+    std::stable_sort(expected.begin(), expected.end(),
+                     [](const pol::PolicyInstruction &lhs, const pol::PolicyInstruction &rhs) {
+                         return std::make_pair(lowercase(lhs.key), lowercase(lhs.value))
+                                 < std::make_pair(lowercase(rhs.key), lowercase(rhs.value));
+                     });
+    pol::PolicyTree deduplicated;
+    for (auto &instruction : expected) {
+        if (!deduplicated.empty()
+            && lowercase(deduplicated.back().key) == lowercase(instruction.key)
+            && lowercase(deduplicated.back().value) == lowercase(instruction.value)) {
+            deduplicated.back() = std::move(instruction);
+        } else {
+            deduplicated.push_back(std::move(instruction));
+        }
+    }
+    assert(canonical.instructions == deduplicated && deduplicated.size() < 20000);
+
+    // Output does not depend on order of distinct pairs.
+    auto shuffled = canonical;
+    std::shuffle(shuffled.instructions.begin(), shuffled.instructions.end(), random);
+    pol::canonicalize(shuffled);
+    assert(shuffled == canonical);
+
+    // Writer option emits the same file without changing input.
+    auto buffer = parser->serialize(canonical);
+    parser->setWriteOptions({ true });
+    assert(parser->serialize(file) == buffer && parser->serializedSize(file) == buffer.size());
+    std::vector<uint8_t> written;
+    pol::VectorSink sink(written);
+    parser->writeTo(sink, file);
+    assert(written == buffer && file.instructions.size() == 20000);
+    parser->setWriteOptions({});
+    assert(parser->serialize(file).size() > buffer.size());
+
+    auto sample = makeSampleFile();
+    pol::canonicalize(sample);
+    assert(sample.instructions.size() == makeSampleFile().instructions.size());
+    assert(std::is_sorted(sample.instructions.begin(), sample.instructions.end(),
+                          [](const pol::PolicyInstruction &lhs, const pol::PolicyInstruction &rhs) {
+                              return lowercase(lhs.key) < lowercase(rhs.key);
+                          }));
+    std::cout << "canonical order of instructions: OK" << std::endl;
+}
+
+#endif // PREGPARSER_TEST_CANONICAL
@@ -0,0 +1,74 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_TEST_COLUMNS
+#define PREGPARSER_TEST_COLUMNS
+
+#include <cassert>
+#include <iostream>
+
+#include <columns.h>
+#include <parser.h>
+
+#include "./buffer.h"
+
+void testPolicyColumns()
+{
+    auto file = makeLargeFile(100);
+    file.instructions.push_back({ pol::PolicyRegType::REG_MULTI_SZ,
+                                  std::vector<std::string>{ "", "a", "" }, "Edge\\Key", "List" });
+    file.instructions.push_back({ pol::PolicyRegType::REG_MULTI_SZ, std::vector<std::string>{},
+                                  "Edge\\Key", "Empty" });
+
+    auto columns = pol::PolicyColumns::fromFile(file);
+    assert(columns.size() == file.instructions.size() && columns.toFile() == file);
+    assert(columns.instruction(7) == file.instructions[7]);
+    assert(columns.types().size() == columns.size());
+    assert(columns.dataSizes().size() == columns.size());
+
+    // Keypaths are interned, values are unique.
+    auto sample = makeSampleFile().instructions;
+    assert(columns.stringCount() < columns.size() + sample.size());
+    assert(columns.string(columns.keypaths()[0]) == sample[0].key);
+    assert(!columns.findString("Absent"));
+
+    // Scan: how many DWORD instructions of keypath have given data.
+    size_t expected = 0;
+    for (const auto &instruction : file.instructions) {
+        auto number = std::get_if<uint32_t>(&instruction.data);
+        expected += instruction.key == sample[0].key
+                && instruction.type == pol::PolicyRegType::REG_DWORD_LITTLE_ENDIAN && number
+                && *number == 0x12345678;
+    }
+
+    auto keypath = *columns.findString(sample[0].key);
+    size_t count = 0;
+    for (size_t i = 0; i < columns.size(); ++i) {
+        count += columns.keypaths()[i] == keypath
+                && columns.types()[i] == pol::PolicyRegType::REG_DWORD_LITTLE_ENDIAN
+                && columns.integer(i) == 0x12345678;
+    }
+    assert(count == expected && count > 0);
+
+    assert(columns.blob(columns.size() - 2) == std::string_view("\0a\0\0", 4));
+    assert(columns.blob(columns.size() - 1).empty() && columns.integer(columns.size() - 1) == 0);
+    std::cout << "columnar policy file: OK" << std::endl;
+}
+
+#endif // PREGPARSER_TEST_COLUMNS
@@ -0,0 +1,72 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_TEST_COMPACT
+#define PREGPARSER_TEST_COMPACT
+
+#include <cassert>
+#include <iostream>
+
+#include <compact.h>
+#include <parser.h>
+
+#include "./buffer.h"
+
+void testCompactFile()
+{
+    static_assert(sizeof(pol::PolicyCompactData) == 16, "Compact data must stay 16 bytes");
+
+    auto parser = pol::createPregParser();
+    auto file = makeLargeFile(100);
+    auto add = [&file](std::string key, pol::PolicyRegType type, pol::PolicyData data) {
+        file.instructions.push_back({ type, std::move(data), std::move(key), "Edge" });
+    };
+    add("Short\\Keypath1", pol::PolicyRegType::REG_MULTI_SZ, std::vector<std::string>{});
+    add("Short\\Keypath12", pol::PolicyRegType::REG_MULTI_SZ,
+        std::vector<std::string>{ "", "a", "", std::string(20, 'b') });
+    add("Software\\Long\\Keypath", pol::PolicyRegType::REG_BINARY,
+        std::vector<uint8_t>{ 0, 1, 0, 2 });
+    add("Software\\Long\\Keypath", pol::PolicyRegType::REG_SZ, std::string(14, 's'));
+    add("Software\\Long\\Keypath", pol::PolicyRegType::REG_QWORD_BIG_ENDIAN,
+        uint64_t(0x0102030405060708));
+
+    auto compact = pol::PolicyCompactFile::fromFile(file);
+    assert(compact.size() == file.instructions.size() && compact.toFile() == file);
+    assert(compact.instruction(5) == file.instructions[5]);
+    assert(compact.key(compact.size() - 1) == "Software\\Long\\Keypath");
+    assert(compact.bytes(compact.size() - 2) == std::string(14, 's'));
+    assert(compact.integer(compact.size() - 1) == 0x0102030405060708);
+    assert(compact.bytes(compact.size() - 1).size() == sizeof(uint64_t));
+    assert(compact.integer(compact.size() - 2) == 0);
+    assert(compact.type(compact.size() - 4) == pol::PolicyRegType::REG_MULTI_SZ);
+
+    // Instructions hold no heap memory of their own, keypaths are shared.
+    assert(compact.memoryUsage() * 2 < file.instructions.size() * sizeof(pol::PolicyInstruction));
+
+    auto buffer = parser->serialize(file);
+    auto parsed = pol::PolicyCompactFile::parse(*parser, buffer.data(), buffer.size());
+    assert(parsed.toFile() == file);
+
+    parser->setLimits({ 1024, 1024 });
+    assert(throwsRuntimeError(
+            [&]() { pol::PolicyCompactFile::parse(*parser, buffer.data(), buffer.size()); }));
+    std::cout << "compact policy file: OK" << std::endl;
+}
+
+#endif // PREGPARSER_TEST_COMPACT
@@ -0,0 +1,71 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_TEST_DIFF
+#define PREGPARSER_TEST_DIFF
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+#include <canonical.h>
+#include <diff.h>
+
+void testDiff()
+{
+    pol::PolicyFile a;
+    pol::PolicyFile b;
+    auto add = [](pol::PolicyFile &file, std::string key, std::string value, uint32_t data) {
+        file.instructions.push_back({ pol::PolicyRegType::REG_DWORD_LITTLE_ENDIAN, data,
+                                      std::move(key), std::move(value) });
+    };
+
+    add(a, "Software\\A", "Same", 1);
+    add(a, "Software\\A", "Changed", 1);
+    add(a, "Software\\A", "Removed", 1);
+    add(a, "Software\\B", "Overridden", 1);
+    add(a, "Software\\B", "Overridden", 2);
+
+    add(b, "Software\\B", "Overridden", 2);
+    add(b, "Software\\C", "Added", 1);
+    add(b, "Software\\A", "Changed", 2);
+    add(b, "Software\\A", "Same", 1);
+
+    auto check = [](const pol::PolicyDiff &result) {
+        assert(result.added.size() == 1 && result.added[0].value == "Added");
+        assert(result.removed.size() == 1 && result.removed[0].value == "Removed");
+        assert(result.changed.size() == 1 && result.changed[0].after.value == "Changed");
+        assert(std::get<uint32_t>(result.changed[0].before.data) == 1);
+    };
+
+    check(pol::diff(a, b));
+    assert(pol::diff(b, b).empty());
+    std::cout << "diff (hashed): OK" << std::endl;
+
+    // Names differ only in case, so they are the same entries.
+    add(b, "software\\a", "SAME", 1);
+    check(pol::diff(a, b));
+
+    pol::canonicalize(a);
+    pol::canonicalize(b);
+    check(pol::diff(a, b));
+    std::cout << "diff (sorted): OK" << std::endl;
+}
+
+#endif // PREGPARSER_TEST_DIFF
@@ -0,0 +1,132 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_TEST_DOCUMENT
+#define PREGPARSER_TEST_DOCUMENT
+
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+
+#include <document.h>
+#include <parser.h>
+
+#include "./buffer.h"
+
+void testPolicyDocument()
+{
+    auto parser = pol::createPregParser();
+    auto expected = makeLargeFile(10);
+    auto buffer = parser->serialize(expected);
+
+    pol::PolicyDocument document(buffer);
+    assert(document.size() == expected.instructions.size());
+    assert(document.save() == buffer && document.spans().size() == 1);
+
+    const auto &third = expected.instructions[3];
+    assert(*document.find(third.key, third.value) == third);
+    assert(!document.find(third.key, third.value + "?") && !document.contains("Absent", "V"));
+
+    // Replaced instruction keeps its position, new one is appended.
+    auto replaced = third;
+    replaced.data = std::string("replaced");
+    replaced.type = pol::PolicyRegType::REG_EXPAND_SZ;
+    document.set(replaced);
+    expected.instructions[3] = replaced;
+
+    pol::PolicyInstruction added;
+    added.key = "Software\\Added";
+    added.value = "Value";
+    added.type = pol::PolicyRegType::REG_DWORD_LITTLE_ENDIAN;
+    added.data = uint32_t(7);
+    assert(document.insert(added) && !document.insert(added));
+    expected.instructions.push_back(added);
+
+    auto erased = expected.instructions[10];
+    assert(document.erase(erased.key, erased.value) && !document.erase(erased.key, erased.value));
+    expected.instructions.erase(expected.instructions.begin() + 10);
+
+    assert(document.size() == expected.instructions.size());
+    assert(*document.find(third.key, third.value) == replaced);
+    assert(document.save() == parser->serialize(expected));
+    assert(document.spans().size() == 5);
+
+    std::vector<uint8_t> saved;
+    pol::VectorSink sink(saved);
+    document.save(sink);
+    assert(saved == parser->serialize(expected));
+
+    // Invalid instruction does not change document.
+    auto invalid = added;
+    invalid.key = "Bad\\\\Key";
+    assert(throwsRuntimeError([&]() { document.set(invalid); }));
+    assert(document.save() == saved);
+
+    // Edit of repeated key replaces all of its instructions.
+    pol::PolicyFile repeated;
+    repeated.instructions = { added, third, added };
+    auto repeatedBuffer = parser->serialize(repeated);
+    pol::PolicyDocument duplicates(repeatedBuffer);
+    assert(duplicates.size() == 2);
+    added.data = uint32_t(8);
+    duplicates.set(added);
+    repeated.instructions = { third, added };
+    assert(duplicates.save() == parser->serialize(repeated));
+    assert(duplicates.erase(added.key, added.value) && duplicates.size() == 1);
+
+    // Names are compared ignoring case, like registry does.
+    auto lower = added;
+    lower.key = "software\\ADDED";
+    lower.value = "vALUE";
+    repeated.instructions = { added, third, lower };
+    pol::PolicyDocument spelled(parser->serialize(repeated));
+    assert(spelled.size() == 2 && *spelled.find("SOFTWARE\\added", "value") == lower);
+    assert(spelled.contains(third.key, third.value) && !spelled.insert(added));
+    assert(spelled.erase("Software\\Added", "Value") && spelled.size() == 1);
+
+    // Repeated edits of the same keys release replaced bytes and drop tombstones.
+    pol::PolicyDocument churned(buffer);
+    auto churn = expected.instructions[5];
+    for (uint32_t i = 0; i < 1000; ++i) {
+        churn.type = pol::PolicyRegType::REG_DWORD_LITTLE_ENDIAN;
+        churn.data = i;
+        churned.set(churn);
+        assert(churned.erase(added.key, added.value) == (i > 0));
+        churned.set(added);
+    }
+    assert(churned.size() == pol::PolicyDocument(buffer).size() + 1);
+    assert(*churned.find(churn.key, churn.value) == churn);
+    assert(*churned.find(added.key, added.value) == added);
+    assert(pol::PolicyDocument(churned.save()).save() == churned.save());
+
+    pol::PolicyDocument empty;
+    assert(empty.size() == 0 && empty.save() == parser->serialize(pol::PolicyFile{}));
+    empty.set(added);
+    assert(empty.save() == parser->serialize({ { added } }));
+
+    auto path = makeTempFile(saved);
+    auto mapped = pol::PolicyDocument::map(path);
+    std::remove(path.c_str());
+    assert(mapped.save() == saved && mapped.spans().size() == 1);
+
+    assert(throwsRuntimeError([]() { pol::PolicyDocument({ 1, 2, 3, 4, 5, 6, 7, 8 }); }));
+    std::cout << "copy-on-write policy document: OK" << std::endl;
+}
+
+#endif // PREGPARSER_TEST_DOCUMENT
@@ -0,0 +1,98 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_TEST_FINGERPRINT
+#define PREGPARSER_TEST_FINGERPRINT
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <sstream>
+
+#include <canonical.h>
+#include <parallel.h>
+#include <parser.h>
+
+#include "./buffer.h"
+
+void testFingerprint()
+{
+    auto parser = pol::createPregParser();
+    auto file = makeLargeFile(5);
+    auto buffer = parser->serialize(file);
+    auto expected = pol::computeFingerprint(file.instructions);
+
+    assert(!parser->parse(buffer.data(), buffer.size()).parsedFingerprint);
+    assert(file.fingerprint() == expected);
+
+    // Every parse records the same fingerprint.
+    parser->setParseOptions({ true });
+    std::stringstream stream(std::string(buffer.begin(), buffer.end()));
+    auto owner = std::make_shared<std::vector<uint8_t>>(buffer);
+    pol::BufferSource source(buffer.data(), buffer.size());
+    for (const auto &parsed :
+         { parser->parse(stream), parser->parse(buffer.data(), buffer.size()),
+           parser->parse(owner, owner->data(), owner->size()), parser->parseFrom(source),
+           pol::parseParallel(buffer.data(), buffer.size(), 2, {}, { true }) }) {
+        assert(parsed == file && parsed.parsedFingerprint == expected);
+        assert(parsed.fingerprint() == expected);
+    }
+
+    pol::ParseManyOptions options;
+    options.parse.fingerprint = true;
+    assert(*pol::parseMany({ buffer }, options)[0].file->parsedFingerprint == expected);
+
+    // Filtered parse fingerprints parsed instructions only.
+    auto filtered = parser->parse(buffer.data(), buffer.size(),
+                                  [](std::string_view, std::string_view value) {
+                                      return value.find("Dword") == std::string_view::npos;
+                                  });
+    assert(filtered.fingerprint() == pol::computeFingerprint(filtered.instructions));
+    assert(filtered.fingerprint() != expected);
+
+    // Order does not matter, content and count of instructions do.
+    auto reordered = file;
+    std::reverse(reordered.instructions.begin(), reordered.instructions.end());
+    assert(reordered.fingerprint() == expected);
+
+    auto repeated = file;
+    repeated.instructions.push_back(repeated.instructions[0]);
+    assert(repeated.fingerprint() != expected);
+
+    // Recorded fingerprint is returned until it is reset after edit.
+    auto changed = parser->parse(buffer.data(), buffer.size());
+    changed.instructions[3].data = std::string("changed");
+    assert(changed.fingerprint() == expected);
+    changed.parsedFingerprint.reset();
+    assert(changed.fingerprint() != expected);
+
+    auto canonical = parser->parse(buffer.data(), buffer.size());
+    canonical.instructions.push_back(canonical.instructions[0]);
+    pol::canonicalize(canonical);
+    assert(!canonical.parsedFingerprint && canonical.fingerprint() == expected);
+
+    pol::PolicyFingerprint merged = pol::computeFingerprint(
+            pol::PolicyTree(file.instructions.begin(), file.instructions.begin() + 10));
+    merged.merge(pol::computeFingerprint(
+            pol::PolicyTree(file.instructions.begin() + 10, file.instructions.end())));
+    assert(merged == expected);
+    std::cout << "order-insensitive fingerprint: OK" << std::endl;
+}
+
+#endif // PREGPARSER_TEST_FINGERPRINT
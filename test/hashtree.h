@@ -0,0 +1,115 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_TEST_HASHTREE
+#define PREGPARSER_TEST_HASHTREE
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+#include <hashtree.h>
+#include <parser.h>
+#include <pushparser.h>
+
+#include "./buffer.h"
+
+void testHashTree()
+{
+    auto parser = pol::createPregParser();
+    auto file = makeLargeFile(3);
+    auto buffer = parser->serialize(file);
+
+    auto tree = pol::PolicyHashTree::build(file);
+    assert(tree.root().count == file.instructions.size());
+    assert(tree.find("Software\\Policies\\Sample\\Multi") != nullptr && !tree.find("Absent"));
+
+    // Tree is filled while file is parsed.
+    pol::PolicyHashTree pushed;
+    pol::PRegPushParser push([&pushed](pol::PolicyInstruction &&instruction) {
+        pushed.add(instruction);
+    });
+    push.feed(buffer.data(), buffer.size());
+    push.finish();
+    pushed.finish();
+    assert(pushed.hash() == tree.hash() && pushed.difference(tree).empty());
+
+    // Order between keypaths does not matter, order within keypath does.
+    auto moved = file;
+    std::rotate(moved.instructions.begin(), moved.instructions.begin() + 1,
+                moved.instructions.end());
+    auto movedTree = pol::PolicyHashTree::build(moved);
+    assert(movedTree.hash() != tree.hash());
+    assert(movedTree.difference(tree) == std::vector<std::string>{ "Software\\Policies\\Sample" });
+
+    // Names differing only in ASCII case are the same key and value.
+    auto spelled = file;
+    auto upper = [](std::string &name) {
+        std::transform(name.begin(), name.end(), name.begin(), [](char sym) {
+            return sym >= 'a' && sym <= 'z' ? static_cast<char>(sym - 'a' + 'A') : sym;
+        });
+    };
+    for (auto &instruction : spelled.instructions) {
+        upper(instruction.key);
+        upper(instruction.value);
+    }
+    auto spelledTree = pol::PolicyHashTree::build(spelled);
+    assert(spelledTree.hash() == tree.hash() && spelledTree.difference(tree).empty());
+    assert(tree.find("SOFTWARE\\policies\\sample") == tree.find("Software\\Policies\\Sample"));
+
+    auto changed = file;
+    auto &multi = *std::find_if(changed.instructions.begin(), changed.instructions.end(),
+                                [](const pol::PolicyInstruction &instruction) {
+                                    return instruction.key == "Software\\Policies\\Sample\\Multi";
+                                });
+    multi.type = pol::PolicyRegType::REG_SZ;
+    multi.data = std::string("changed");
+    pol::PolicyInstruction added = multi;
+    added.key = "Software\\Other\\Added";
+    changed.instructions.push_back(added);
+
+    auto changedTree = pol::PolicyHashTree::build(changed);
+    assert(changedTree.hash() != tree.hash());
+    assert(changedTree.find("Software\\Policies")->hash != tree.find("Software\\Policies")->hash);
+    assert(changedTree.find("Software\\Policies\\Sample")->own
+           == tree.find("Software\\Policies\\Sample")->own);
+    auto difference = changedTree.difference(tree);
+    assert((difference
+            == std::vector<std::string>{ "Software\\Other", "Software\\Policies\\Sample\\Multi" }));
+    assert(tree.difference(changedTree) == difference);
+
+    // Every key is a level of tree, traversals and teardown must not recurse per level.
+    pol::PolicyInstruction deep = added;
+    deep.key = "Deep";
+    for (size_t level = 0; level < 100000; ++level) {
+        deep.key += "\\K";
+    }
+    pol::PolicyHashTree deepTree;
+    deepTree.add(deep);
+    deepTree.finish();
+    pol::PolicyHashTree deepChanged;
+    deep.value = "changed";
+    deepChanged.add(deep);
+    deepChanged.finish();
+    assert(deepTree.hash() != deepChanged.hash() && deepTree.find(deep.key) != nullptr);
+    assert(deepTree.difference(deepChanged) == std::vector<std::string>{ deep.key });
+    std::cout << "hash tree over keypaths: OK" << std::endl;
+}
+
+#endif // PREGPARSER_TEST_HASHTREE
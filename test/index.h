@@ -0,0 +1,65 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_TEST_INDEX
+#define PREGPARSER_TEST_INDEX
+
+#include <cassert>
+#include <iostream>
+#include <sstream>
+
+#include <index.h>
+
+#include "./serialize.h"
+
+void testPolicyIndex()
+{
+    auto parser = pol::createPregParser();
+    auto file = makeSampleFile();
+    std::stringstream policy;
+    std::stringstream sidecar;
+
+    file.instructions.push_back(file.instructions[5]);
+    std::get<uint32_t>(file.instructions.back().data) = 42;
+
+    parser->write(policy, file);
+    policy.seekg(0);
+    pol::PolicyIndex::build(*parser, policy).save(sidecar);
+
+    auto index = pol::PolicyIndex::load(sidecar);
+    assert(index.size() == file.instructions.size());
+    assert(index.sourceSize() == policy.str().size());
+
+    for (size_t i = 0; i < file.instructions.size() - 1; ++i) {
+        if (i == 5) {
+            continue;
+        }
+        const auto &expected = file.instructions[i];
+        assert(index.lookup(*parser, policy, expected.key, expected.value) == expected);
+    }
+
+    auto overridden = index.lookup(*parser, policy, "Software\\Policies\\Sample", "Dword");
+    assert(std::get<uint32_t>(overridden->data) == 42);
+    overridden = index.lookup(*parser, policy, "SOFTWARE\\policies\\sample", "DWORD");
+    assert(std::get<uint32_t>(overridden->data) == 42);
+    assert(!index.lookup(*parser, policy, "Software\\Policies\\Sample", "Missing"));
+    std::cout << "sidecar index lookup: OK" << std::endl;
+}
+
+#endif // PREGPARSER_TEST_INDEX
@@ -0,0 +1,136 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_TEST_LIMITS
+#define PREGPARSER_TEST_LIMITS
+
+#include <cassert>
+#include <iostream>
+#include <sstream>
+
+#include <binary.h>
+#include <parallel.h>
+#include <parser.h>
+#include <pushparser.h>
+
+#include "./buffer.h"
+
+/*!
+ * \brief Header and beginning of instruction `[A;;REG_BINARY;0xFFFFFFF0;` with no data
+ */
+std::vector<uint8_t> makeForgedFile()
+{
+    std::vector<uint8_t> result = { 0x50, 0x52, 0x65, 0x67, 0x01, 0x00, 0x00, 0x00 };
+    auto put = [&result](std::initializer_list<uint8_t> bytes) {
+        result.insert(result.end(), bytes);
+    };
+
+    put({ '[', 0, 'A', 0, 0, 0, ';', 0, 0, 0, ';', 0 });
+    put({ 3, 0, 0, 0, ';', 0 });
+    put({ 0xF0, 0xFF, 0xFF, 0xFF, ';', 0 });
+
+    return result;
+}
+
+void testParseLimits()
+{
+    auto parser = pol::createPregParser();
+    auto forged = makeForgedFile();
+
+    // Forged size is rejected by remaining input, nothing of its size is allocated.
+    std::stringstream stream(std::string(forged.begin(), forged.end()));
+    assert(throwsRuntimeError([&]() { parser->parse(stream); }));
+    NonSeekableBuffer pipe(forged, 7);
+    std::istream pipeStream(&pipe);
+    assert(throwsRuntimeError([&]() { parser->parse(pipeStream); }));
+    assert(throwsRuntimeError([&]() { parser->parse(forged.data(), forged.size()); }));
+    std::stringstream data(std::string(100, '\0'));
+    assert(throwsRuntimeError([&]() { pol::readVectorFromBuffer(data, 0xFFFFFFF0); }));
+
+    auto file = makeLargeFile(10);
+    auto buffer = parser->serialize(file);
+    auto getMemory = [&buffer]() {
+        pol::ParseUsage usage;
+        for (const auto &bounds : pol::scanInstructions(buffer.data(), buffer.size())) {
+            pol::checkLimits({}, usage, buffer.data(), bounds);
+        }
+        return usage.memory;
+    };
+    auto parseAll = [&](const pol::ParseLimits &limits) {
+        parser->setLimits(limits);
+
+        std::stringstream input(std::string(buffer.begin(), buffer.end()));
+        bool stream = !throwsRuntimeError([&]() { assert(parser->parse(input) == file); });
+        bool memory = !throwsRuntimeError(
+                [&]() { assert(parser->parse(buffer.data(), buffer.size()) == file); });
+        bool parallel = !throwsRuntimeError(
+                [&]() { pol::parseParallel(buffer.data(), buffer.size(), 2, limits); });
+
+        pol::PRegPushParser push([](pol::PolicyInstruction &&) {}, limits);
+        bool pushed = !throwsRuntimeError([&]() {
+            for (size_t offset = 0; offset < buffer.size(); offset += 16) {
+                push.feed(buffer.data() + offset, std::min<size_t>(16, buffer.size() - offset));
+            }
+            push.finish();
+        });
+
+        pol::ParseManyOptions options;
+        options.limits = limits;
+        bool many = pol::parseMany(std::vector<std::vector<uint8_t>>{ buffer }, options)[0].ok();
+
+        assert(stream == memory && memory == parallel && parallel == pushed && pushed == many);
+        return stream;
+    };
+
+    pol::ParseLimits limits;
+    assert(parseAll(limits));
+
+    limits.maxInstructionCount = file.instructions.size();
+    assert(parseAll(limits));
+    limits.maxInstructionCount = file.instructions.size() - 1;
+    assert(!parseAll(limits));
+
+    limits = {};
+    limits.maxTotalSize = getMemory();
+    assert(parseAll(limits));
+    limits.maxTotalSize = getMemory() - 1;
+    assert(!parseAll(limits));
+
+    // Empty strings take 2 bytes in file, but a whole std::string each in memory.
+    file.instructions = { { pol::PolicyRegType::REG_MULTI_SZ,
+                            std::vector<std::string>(0x8000, std::string()), "Software\\A",
+                            "Empty" } };
+    buffer = parser->serialize(file);
+    limits.maxTotalSize = buffer.size() * 4;
+    assert(!parseAll(limits));
+    assert(getMemory() > 0x8000 * sizeof(std::string));
+    limits.maxTotalSize = getMemory();
+    assert(parseAll(limits));
+
+    limits = {};
+    limits.maxInstructionSize = 100;
+    assert(!parseAll(limits));
+
+    // Push parser does not wait for data of forged instruction, its size is already known.
+    pol::PRegPushParser push([](pol::PolicyInstruction &&) {}, limits);
+    assert(throwsRuntimeError([&]() { push.feed(forged.data(), forged.size()); }));
+    std::cout << "parse limits: OK" << std::endl;
+}
+
+#endif // PREGPARSER_TEST_LIMITS
@@ -0,0 +1,97 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_TEST_LOADER
+#define PREGPARSER_TEST_LOADER
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+
+#include <loader.h>
+#include <parallel.h>
+
+#include "./buffer.h"
+
+void testLoadFiles()
+{
+    auto parser = pol::createPregParser();
+    std::vector<std::string> paths;
+    std::vector<std::vector<uint8_t>> buffers;
+
+    for (size_t i = 0; i < 100; ++i) {
+        buffers.push_back(parser->serialize(makeLargeFile(i % 10 == 0 ? 500 : i % 3)));
+        paths.push_back(makeTempFile(buffers.back()));
+    }
+    paths.push_back(makeTempFile());
+    std::remove(paths.back().c_str());
+
+    auto files = pol::loadFiles(paths, 16);
+    assert(files.size() == paths.size() && !files.back().ok());
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        assert(files[i].ok() && files[i].data == buffers[i]);
+    }
+    // Files are passed as they are read, each one once.
+    std::vector<size_t> received(paths.size(), 0);
+    pol::loadFiles(
+            paths,
+            [&](size_t index, pol::LoadedFile &&file) {
+                assert(index + 1 == paths.size() ? !file.ok() : file.data == buffers[index]);
+                ++received[index];
+            },
+            16);
+    assert(std::all_of(received.begin(), received.end(), [](size_t count) { return count == 1; }));
+
+    // Exception of callback stops loading, reads in flight are waited for.
+    size_t count = 0;
+    assert(throwsRuntimeError([&]() {
+        pol::loadFiles(
+                paths,
+                [&count](size_t, pol::LoadedFile &&) {
+                    if (++count == 3) {
+                        throw std::runtime_error("Stop.");
+                    }
+                },
+                16);
+    }));
+    assert(count == 3);
+    std::cout << "load files (io_uring: " << (pol::isIoUringAvailable() ? "yes" : "no")
+              << "): OK" << std::endl;
+
+    // Loader parses files itself or hands them to workers.
+    for (size_t threads : { 1, 4 }) {
+        pol::ParseManyOptions options;
+        options.batchRead = true;
+        options.threads = threads;
+        auto results = pol::parseMany(paths, options);
+        assert(!results.back().ok());
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            assert(results[i].ok());
+            assert(*results[i].file == parser->parse(buffers[i].data(), buffers[i].size()));
+        }
+    }
+    std::cout << "parse many files with batch read: OK" << std::endl;
+
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        std::remove(paths[i].c_str());
+    }
+}
+
+#endif // PREGPARSER_TEST_LOADER
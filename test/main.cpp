@@ -21,8 +21,25 @@
 #include <parser.h>
 
 #include "./binary.h"
+#include "./buffer.h"
+#include "./canonical.h"
+#include "./columns.h"
+#include "./compact.h"
 #include "./endian.h"
+#include "./diff.h"
+#include "./document.h"
+#include "./fingerprint.h"
 #include "./generatecase.h"
+#include "./hashtree.h"
+#include "./index.h"
+#include "./limits.h"
+#include "./patch.h"
+#include "./raw.h"
+#include "./loader.h"
+#include "./registry.h"
+#include "./serialize.h"
+#include "./source.h"
+#include "./writer.h"
 
 #include <iconv.h>
 
@@ -35,5 +52,30 @@ int main()
     testCase("case2.pol");
     generateCase(100);
 */
+    testRegistryModel();
+    testDiff();
+    testWriteRoundTrip();
+    testSerializeToBuffer();
+    testMultiStringDecode();
+    testFilteredParse();
+    testScanMetadata();
+    testPolicyIndex();
+    testBufferParse();
+    testParallelParse();
+    testParseMany();
+    testLoadFiles();
+    testPushParser();
+    testNonSeekableParse();
+    testSourcesAndSinks();
+    testParseLimits();
+    testIncrementalWriter();
+    testRawPassthrough();
+    testPolicyDocument();
+    testPatch();
+    testHashTree();
+    testCanonicalOrder();
+    testFingerprint();
+    testCompactFile();
+    testPolicyColumns();
     return 0;
 }
@@ -0,0 +1,70 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_TEST_PATCH
+#define PREGPARSER_TEST_PATCH
+
+#include <cassert>
+#include <iostream>
+
+#include <parser.h>
+#include <patch.h>
+
+#include "./buffer.h"
+
+void testPatch()
+{
+    auto parser = pol::createPregParser();
+    auto file = makeLargeFile(50);
+    auto base = parser->serialize(file);
+
+    // Unchanged file is one copy of the whole base.
+    auto same = pol::makePatch(base, base);
+    assert(same.size() == 65 && pol::applyPatch(base, same) == base);
+
+    file.instructions[3].data = std::string("changed");
+    file.instructions.erase(file.instructions.begin() + 100);
+    file.instructions.push_back(file.instructions[7]);
+    std::swap(file.instructions[200], file.instructions[300]);
+    auto added = file.instructions[0];
+    added.value = "Added";
+    file.instructions.insert(file.instructions.begin() + 50, added);
+    auto target = parser->serialize(file);
+
+    auto patch = pol::makePatch(base, target);
+    assert(patch.size() < target.size() / 10);
+    assert(pol::applyPatch(base, patch) == target);
+    assert(pol::applyPatch(target, pol::makePatch(target, base)) == base);
+
+    auto empty = parser->serialize(pol::PolicyFile{});
+    assert(pol::applyPatch(empty, pol::makePatch(empty, target)) == target);
+    assert(pol::applyPatch(target, pol::makePatch(target, empty)) == empty);
+
+    // Patch is checked against base and its own structure.
+    assert(throwsRuntimeError([&]() { pol::applyPatch(target, patch); }));
+    auto truncated = patch;
+    truncated.pop_back();
+    assert(throwsRuntimeError([&]() { pol::applyPatch(base, truncated); }));
+    auto corrupted = patch;
+    corrupted[56] ^= 0xFF;
+    assert(throwsRuntimeError([&]() { pol::applyPatch(base, corrupted); }));
+    std::cout << "binary patch between file versions: OK" << std::endl;
+}
+
+#endif // PREGPARSER_TEST_PATCH
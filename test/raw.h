@@ -0,0 +1,79 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_TEST_RAW
+#define PREGPARSER_TEST_RAW
+
+#include <cassert>
+#include <iostream>
+#include <memory>
+
+#include <parser.h>
+#include <writer.h>
+
+#include "./buffer.h"
+
+void testRawPassthrough()
+{
+    auto parser = pol::createPregParser();
+    auto source = makeLargeFile(20);
+    auto owner = std::make_shared<std::vector<uint8_t>>(parser->serialize(source));
+    auto buffer = *owner;
+
+    auto file = parser->parse(owner, owner->data(), owner->size());
+    owner.reset();
+    assert(file == source && pol::isRawValid(file.instructions[0]));
+    assert(parser->serialize(file) == buffer);
+
+    // Modified instructions drop raw bytes and are encoded again, the rest is copied.
+    file.instructions[0].data = std::string("changed");
+    file.instructions[2].type = pol::PolicyRegType::REG_EXPAND_SZ;
+    file.instructions[3].value = "Changed";
+    for (size_t i : { 0, 2, 3 }) {
+        file.instructions[i].raw = {};
+    }
+    assert(!pol::isRawValid(file.instructions[3]) && pol::isRawValid(file.instructions[4]));
+
+    auto plain = file;
+    for (auto &instruction : plain.instructions) {
+        instruction.raw = {};
+    }
+    auto written = parser->serialize(file);
+    assert(written == parser->serialize(plain));
+    assert(parser->parse(written.data(), written.size()) == file);
+
+    // Non-canonical encoding survives round trip: REG_MULTI_SZ without final '\0' is decoded as
+    // empty list, but its bytes are kept.
+    std::vector<uint8_t> odd = { 0x50, 0x52, 0x65, 0x67, 0x01, 0x00, 0x00, 0x00,
+                                 '[', 0, 'K', 0, 0, 0, ';', 0, 'V', 0, 0, 0, ';', 0,
+                                 7, 0, 0, 0, ';', 0, 6, 0, 0, 0, ';', 0,
+                                 'a', 0, 0, 0, 'b', 0, ']', 0 };
+    auto oddOwner = std::make_shared<std::vector<uint8_t>>(odd);
+    auto oddFile = parser->parse(oddOwner, oddOwner->data(), oddOwner->size());
+    assert(parser->serialize(oddFile) == odd && parser->serializedSize(oddFile) == odd.size());
+
+    std::vector<uint8_t> streamed;
+    pol::VectorSink sink(streamed);
+    pol::PRegWriter<pol::VectorSink> writer(sink);
+    writer.add(oddFile.instructions[0]);
+    assert(streamed == odd);
+    std::cout << "raw passthrough of unmodified instructions: OK" << std::endl;
+}
+
+#endif // PREGPARSER_TEST_RAW
@@ -0,0 +1,85 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_TEST_REGISTRY
+#define PREGPARSER_TEST_REGISTRY
+
+#include <cassert>
+#include <iostream>
+
+#include <registry.h>
+
+void testRegistryModel()
+{
+    pol::PolicyFile file;
+    auto add = [&file](std::string key, std::string value, pol::PolicyRegType type,
+                       pol::PolicyData data) {
+        file.instructions.push_back({ type, std::move(data), std::move(key), std::move(value) });
+    };
+
+    add("Software\\Policies\\A", "One", pol::PolicyRegType::REG_DWORD_LITTLE_ENDIAN, uint32_t(1));
+    add("Software\\Policies\\A", "Two", pol::PolicyRegType::REG_SZ, std::string("2"));
+    add("Software\\Policies\\A", "Three", pol::PolicyRegType::REG_SZ, std::string("3"));
+    add("Software\\Policies\\A\\B", "Four", pol::PolicyRegType::REG_SZ, std::string("4"));
+    add("Software\\Policies\\C", "Five", pol::PolicyRegType::REG_SZ, std::string("5"));
+    add("software\\policies\\a", "**del.one", pol::PolicyRegType::REG_SZ, std::string(" "));
+    add("Software\\Policies\\A", "**DeleteValues", pol::PolicyRegType::REG_SZ,
+        std::string("Two;Missing"));
+    add("Software\\Policies", "**DeleteKeys", pol::PolicyRegType::REG_SZ, std::string("C;A\\B"));
+    add("Software\\Policies\\A", "**soft.Three", pol::PolicyRegType::REG_SZ, std::string("x"));
+    add("Software\\Policies\\A", "**SecureKey", pol::PolicyRegType::REG_DWORD_LITTLE_ENDIAN,
+        uint32_t(1));
+
+    pol::RegistryModel model;
+    model.apply(file);
+
+    assert(model.findValue("Software\\Policies\\A", "One") == nullptr);
+    assert(model.findValue("Software\\Policies\\A", "Two") == nullptr);
+    assert(std::get<std::string>(model.findValue("Software\\Policies\\A", "three")->data) == "3");
+    assert(model.findKey("Software\\Policies\\A\\B") == nullptr);
+    assert(model.findKey("Software\\Policies\\C") == nullptr);
+    assert(model.findKey("SOFTWARE\\Policies\\A")->secure);
+    std::cout << "RegistryModel special values: OK" << std::endl;
+
+    model.apply({ pol::PolicyRegType::REG_SZ, std::string(" "), "Software\\Policies\\A",
+                  "**delvals." });
+    assert(model.findKey("Software\\Policies\\A")->values.empty());
+    std::cout << "RegistryModel **delvals.: OK" << std::endl;
+
+    // Every key is a level of tree, deleting and destroying it must not recurse per level.
+    std::string deep = "Deep";
+    for (size_t level = 0; level < 200000; ++level) {
+        deep += "\\K";
+    }
+    {
+        pol::RegistryModel deepModel;
+        deepModel.apply({ pol::PolicyRegType::REG_SZ, std::string("1"), deep, "Value" });
+        deepModel.apply({ pol::PolicyRegType::REG_SZ, std::string("1"), deep + "\\K", "" });
+        assert(deepModel.findValue(deep, "value") != nullptr);
+        deepModel.apply({ pol::PolicyRegType::REG_SZ, std::string("Deep"), "", "**DeleteKeys" });
+        assert(deepModel.findKey("Deep") == nullptr);
+        deepModel.apply({ pol::PolicyRegType::REG_SZ, std::string("1"), deep, "Value" });
+    }
+    model.apply({ pol::PolicyRegType::REG_SZ, std::string("1"), deep, "Value" });
+    model.clear();
+    assert(model.root().subkeys.empty());
+    std::cout << "RegistryModel deep keypath: OK" << std::endl;
+}
+
+#endif // PREGPARSER_TEST_REGISTRY
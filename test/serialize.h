@@ -0,0 +1,185 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_TEST_SERIALIZE
+#define PREGPARSER_TEST_SERIALIZE
+
+#include <cassert>
+#include <iostream>
+#include <sstream>
+
+#include <binary.h>
+#include <parser.h>
+
+/*!
+ * \brief File with every kind of data, including non-ASCII strings
+ */
+pol::PolicyFile makeSampleFile()
+{
+    pol::PolicyFile file;
+    auto add = [&file](std::string key, std::string value, pol::PolicyRegType type,
+                       pol::PolicyData data) {
+        file.instructions.push_back({ type, std::move(data), std::move(key), std::move(value) });
+    };
+
+    add("Software\\Policies\\Sample", "String", pol::PolicyRegType::REG_SZ,
+        std::string("Ascii"));
+    add("Software\\Policies\\Sample", "Expand", pol::PolicyRegType::REG_EXPAND_SZ,
+        std::string("%HOME%/\xD0\xBF\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82"));
+    add("Software\\Policies\\Sample", "Surrogate", pol::PolicyRegType::REG_SZ,
+        std::string("\xF0\x9F\x98\x80 \xE2\x82\xAC"));
+    add("Software\\Policies\\Sample", "Empty", pol::PolicyRegType::REG_SZ, std::string());
+    add("Software\\Policies\\Sample", "Binary", pol::PolicyRegType::REG_BINARY,
+        std::vector<uint8_t>{ 0x00, 0x5D, 0x00, 0x3B, 0xFF });
+    add("Software\\Policies\\Sample", "Dword", pol::PolicyRegType::REG_DWORD_LITTLE_ENDIAN,
+        uint32_t(0x12345678));
+    add("Software\\Policies\\Sample", "DwordBE", pol::PolicyRegType::REG_DWORD_BIG_ENDIAN,
+        uint32_t(0x12345678));
+    add("Software\\Policies\\Sample\\Multi", "List", pol::PolicyRegType::REG_MULTI_SZ,
+        std::vector<std::string>{ "first", "\xD0\xB2\xD1\x82\xD0\xBE\xD1\x80\xD0\xBE\xD0\xB9",
+                                  "third" });
+    add("Software\\Policies\\Sample\\Multi", "Qword", pol::PolicyRegType::REG_QWORD_LITTLE_ENDIAN,
+        uint64_t(0x123456789ABCDEF0));
+    add("Software\\Policies\\Sample\\Multi", "QwordBE", pol::PolicyRegType::REG_QWORD_BIG_ENDIAN,
+        uint64_t(0x123456789ABCDEF0));
+
+    return file;
+}
+
+void testWriteRoundTrip()
+{
+    auto parser = pol::createPregParser();
+    auto file = makeSampleFile();
+    std::stringstream stream;
+
+    parser->write(stream, file);
+    stream.seekg(0);
+    assert(parser->parse(stream) == file);
+    std::cout << "write/parse round trip: OK" << std::endl;
+}
+
+void testSerializeToBuffer()
+{
+    auto parser = pol::createPregParser();
+    auto file = makeSampleFile();
+    std::stringstream stream;
+
+    parser->write(stream, file);
+    auto expected = stream.str();
+
+    assert(parser->serializedSize(file) == expected.size());
+    auto buffer = parser->serialize(file);
+    assert(std::string(buffer.begin(), buffer.end()) == expected);
+
+    bool thrown = false;
+    try {
+        parser->serializeInto(file, buffer.data(), buffer.size() - 1);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+    std::cout << "serialize to buffer: OK" << std::endl;
+}
+
+void testMultiStringDecode()
+{
+    auto parser = pol::createPregParser();
+    pol::PolicyFile file;
+    std::vector<std::string> list;
+
+    // Strings mix symbols of 1 to 4 bytes in UTF-8, output of conversion is sized exactly.
+    for (size_t i = 0; i < 3000; ++i) {
+        list.push_back(i % 3 == 0 ? std::string()
+                                  : "\xD0\xBF\xE2\x82\xAC\xF0\x9F\x98\x80" + std::to_string(i));
+    }
+    file.instructions.push_back({ pol::PolicyRegType::REG_MULTI_SZ, list, "Key", "List" });
+
+    auto buffer = parser->serialize(file);
+    assert(parser->parse(buffer.data(), buffer.size()) == file);
+    std::stringstream stream(std::string(buffer.begin(), buffer.end()));
+    assert(parser->parse(stream) == file);
+
+    auto conv = iconv_open("UTF-8", "UTF-16LE");
+    const uint8_t single[] = { 0, 0 };
+    const uint8_t trailing[] = { 'a', 0, 0, 0, 0, 0 };
+    const uint8_t surrogate[] = { 'a', 0, 0x3D, 0xD8, 0, 0, 'b', 0, 0, 0 };
+    assert(pol::readStringsFromMemory(single, sizeof(single), conv)
+           == std::vector<std::string>{ "" });
+    assert((pol::readStringsFromMemory(trailing, sizeof(trailing), conv)
+            == std::vector<std::string>{ "a", "" }));
+
+    bool thrown = false;
+    try {
+        pol::readStringsFromMemory(surrogate, sizeof(surrogate), conv);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+    iconv_close(conv);
+    std::cout << "REG_MULTI_SZ decode in single pass: OK" << std::endl;
+}
+
+void testFilteredParse()
+{
+    auto parser = pol::createPregParser();
+    auto file = makeSampleFile();
+    std::stringstream stream;
+
+    parser->write(stream, file);
+    stream.seekg(0);
+
+    auto filtered =
+            parser->parse(stream, pol::keypathPrefixFilter("software\\POLICIES\\sample\\multi"));
+    assert(filtered.instructions.size() == 3);
+    assert(filtered.instructions[0] == file.instructions[7]);
+    assert(filtered.instructions[2] == file.instructions[9]);
+
+    stream.clear();
+    stream.seekg(0);
+    filtered = parser->parse(stream, [](std::string_view, std::string_view value) {
+        return value == "Dword";
+    });
+    assert(filtered.instructions.size() == 1 && filtered.instructions[0] == file.instructions[5]);
+    std::cout << "filtered parse: OK" << std::endl;
+}
+
+void testScanMetadata()
+{
+    auto parser = pol::createPregParser();
+    auto file = makeSampleFile();
+    std::stringstream stream;
+
+    parser->write(stream, file);
+    stream.seekg(0);
+
+    auto infos = parser->scanMetadata(stream);
+    assert(infos.size() == file.instructions.size());
+    assert(infos[0].offset == 8);
+    for (size_t i = 0; i < infos.size(); ++i) {
+        assert(infos[i].key == file.instructions[i].key);
+        assert(infos[i].value == file.instructions[i].value);
+        assert(infos[i].type == file.instructions[i].type);
+        assert(infos[i].dataOffset + infos[i].size + 2
+               == (i + 1 < infos.size() ? infos[i + 1].offset : stream.str().size()));
+    }
+    assert(infos[5].size == 4);
+    std::cout << "scan metadata: OK" << std::endl;
+}
+
+#endif // PREGPARSER_TEST_SERIALIZE
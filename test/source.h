@@ -0,0 +1,106 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_TEST_SOURCE
+#define PREGPARSER_TEST_SOURCE
+
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <parser.h>
+#include <sink.h>
+#include <source.h>
+
+#include "./buffer.h"
+
+void testSourcesAndSinks()
+{
+    auto parser = pol::createPregParser();
+    auto file = makeLargeFile(3000);
+    auto buffer = parser->serialize(file);
+    auto path = makeTempFile();
+
+    std::vector<uint8_t> vector;
+    pol::VectorSink vectorSink(vector);
+    parser->writeTo(vectorSink, file);
+    assert(vector == buffer);
+
+    std::vector<uint8_t> small(buffer.size() - 1);
+    pol::BufferSink smallSink(small.data(), small.size());
+    assert(throwsRuntimeError([&]() { parser->writeTo(smallSink, file); }));
+
+    // Invalid instruction is rejected before anything of it is written.
+    pol::PolicyFile valid{ { file.instructions[0] } };
+    auto validBuffer = parser->serialize(valid);
+    for (auto invalid : { pol::PolicyInstruction{ pol::PolicyRegType::REG_DWORD_LITTLE_ENDIAN,
+                                                  std::string("1"), "Key", "Value" },
+                          pol::PolicyInstruction{ pol::PolicyRegType::REG_SZ,
+                                                  std::string("\xFF\xFE"), "Key", "Value" } }) {
+        auto broken = valid;
+        broken.instructions.push_back(invalid);
+        vector.clear();
+        assert(throwsRuntimeError([&]() { parser->writeTo(vectorSink, broken); }));
+        assert(vector == validBuffer);
+    }
+
+    std::stringstream stream;
+    pol::StreamSink streamSink(stream);
+    parser->writeTo(streamSink, file);
+    assert(stream.str() == std::string(buffer.begin(), buffer.end()));
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    assert(fd >= 0);
+    pol::FdSink fdSink(fd);
+    parser->writeTo(fdSink, file);
+    ::close(fd);
+
+    pol::BufferSource bufferSource(buffer.data(), buffer.size());
+    assert(parser->parseFrom(bufferSource) == file && bufferSource.eof());
+
+    pol::MmapSource mmapSource(path);
+    assert(parser->parseFrom(mmapSource) == file);
+
+    fd = ::open(path.c_str(), O_RDONLY);
+    assert(fd >= 0);
+    {
+        pol::FdSource fdSource(fd, 1000);
+        assert(parser->parseFrom(fdSource) == file);
+    }
+    ::close(fd);
+
+    auto filter = pol::keypathPrefixFilter("Software\\Policies\\Sample\\Multi");
+    stream.seekg(0);
+    pol::StreamSource streamSource(stream);
+    auto filtered = parser->parseFrom(streamSource, filter);
+    assert(filtered.instructions.size() == 3 * 3000);
+    assert(filtered == parser->parse(buffer.data(), buffer.size(), filter));
+
+    pol::BufferSource truncated(buffer.data(), buffer.size() - 1);
+    assert(throwsRuntimeError([&]() { parser->parseFrom(truncated); }));
+
+    std::remove(path.c_str());
+    std::cout << "byte sources and sinks: OK" << std::endl;
+}
+
+#endif // PREGPARSER_TEST_SOURCE
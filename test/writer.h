@@ -0,0 +1,126 @@
+/*
+ * libparsepol - POL Registry file parser
+ *
+ * Copyright (C) 2024 BaseALT Ltd.
+ * Copyright (C) 2020 Korney Yakovlevich
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PREGPARSER_TEST_WRITER
+#define PREGPARSER_TEST_WRITER
+
+#include <cassert>
+#include <iostream>
+#include <sstream>
+
+#include <parser.h>
+#include <writer.h>
+
+#include "./buffer.h"
+
+void testIncrementalWriter()
+{
+    auto parser = pol::createPregParser();
+    auto file = makeLargeFile(100);
+    auto expected = parser->serialize(file);
+
+    std::vector<uint8_t> buffer;
+    pol::VectorSink vectorSink(buffer);
+    pol::PRegWriter<pol::VectorSink> writer(vectorSink);
+    for (const auto &instruction : file.instructions) {
+        writer.add(instruction);
+    }
+    assert(writer.count() == file.instructions.size());
+    assert(buffer == expected);
+
+    std::stringstream stream;
+    {
+        pol::StreamSink streamSink(stream);
+        pol::PRegWriter<pol::StreamSink> streamWriter(streamSink);
+        for (const auto &instruction : file.instructions) {
+            streamWriter.add(instruction);
+        }
+        streamWriter.flush();
+    }
+    assert(stream.str() == std::string(expected.begin(), expected.end()));
+
+    // Borrowed views produce the same instructions as owning data.
+    std::string key = "Software\\Policies\\Views";
+    std::string text = "\xD0\xBF\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82";
+    uint8_t bytes[] = { 1, 2, 3 };
+    buffer.clear();
+    pol::PRegWriter<pol::VectorSink> viewWriter(vectorSink);
+    viewWriter.addString(key, "String", pol::PolicyRegType::REG_SZ, text);
+    viewWriter.addStrings(key, "List", pol::PolicyRegType::REG_MULTI_SZ, { "a", text, "" });
+    viewWriter.addBinary(key, "Binary", bytes, sizeof(bytes));
+    viewWriter.addInteger(key, "Dword", pol::PolicyRegType::REG_DWORD_BIG_ENDIAN, 7);
+    viewWriter.addInteger(key, "Qword", pol::PolicyRegType::REG_QWORD_LITTLE_ENDIAN, 1ULL << 40);
+    viewWriter.addString(key, "", pol::PolicyRegType::REG_SZ, "");
+
+    pol::PolicyFile views;
+    views.instructions = {
+        { pol::PolicyRegType::REG_SZ, text, key, "String" },
+        { pol::PolicyRegType::REG_MULTI_SZ, std::vector<std::string>{ "a", text, "" }, key,
+          "List" },
+        { pol::PolicyRegType::REG_BINARY, std::vector<uint8_t>{ 1, 2, 3 }, key, "Binary" },
+        { pol::PolicyRegType::REG_DWORD_BIG_ENDIAN, uint32_t(7), key, "Dword" },
+        { pol::PolicyRegType::REG_QWORD_LITTLE_ENDIAN, uint64_t(1ULL << 40), key, "Qword" },
+        { pol::PolicyRegType::REG_SZ, std::string(), key, "" },
+    };
+    assert(parser->parse(buffer.data(), buffer.size()) == views);
+
+    // Invalid instructions are rejected before anything of them is written.
+    auto size = buffer.size();
+    assert(throwsRuntimeError(
+            [&]() { viewWriter.addString("A\\\\B", "V", pol::PolicyRegType::REG_SZ, ""); }));
+    assert(throwsRuntimeError([&]() {
+        viewWriter.addString(key, std::string(260, 'v'), pol::PolicyRegType::REG_SZ, "");
+    }));
+    assert(throwsRuntimeError(
+            [&]() { viewWriter.addString(key, "V", pol::PolicyRegType::REG_BINARY, ""); }));
+    assert(throwsRuntimeError([&]() {
+        viewWriter.addInteger(key, "V", pol::PolicyRegType::REG_DWORD_LITTLE_ENDIAN, 1ULL << 32);
+    }));
+    assert(throwsRuntimeError(
+            [&]() { viewWriter.add(key, "V", pol::PolicyRegType::REG_SZ, uint32_t(1)); }));
+    // Truncated, overlong, surrogate and out of range UTF-8.
+    for (std::string invalid :
+         { "\xFF\xFE", "a\xD0", "\xC0\xAF", "\xED\xA0\x80", "\xF4\x90\x80\x80" }) {
+        assert(throwsRuntimeError(
+                [&]() { viewWriter.addString(key, "V", pol::PolicyRegType::REG_SZ, invalid); }));
+        assert(throwsRuntimeError([&]() {
+            viewWriter.addStrings(key, "V", pol::PolicyRegType::REG_MULTI_SZ, { "a", invalid });
+        }));
+    }
+    assert(buffer.size() == size && viewWriter.count() == views.instructions.size());
+
+    // Parser writes accept and reject the same instructions as PRegWriter.
+    for (auto [keypath, value] : std::vector<std::pair<std::string, std::string>>{
+                 { "A\\\\B", "V" }, { "", "V" }, { "A\\", "V" }, { "\xD0\xBF", "V" },
+                 { key, std::string(260, 'v') }, { key, "\x01" } }) {
+        pol::PolicyFile invalid;
+        invalid.instructions = { { pol::PolicyRegType::REG_SZ, std::string(), keypath, value } };
+        std::stringstream output;
+        assert(throwsRuntimeError([&]() { parser->write(output, invalid); }));
+        assert(throwsRuntimeError([&]() { parser->serialize(invalid); }));
+        assert(throwsRuntimeError([&]() {
+            viewWriter.addString(keypath, value, pol::PolicyRegType::REG_SZ, "");
+        }));
+    }
+    auto serialized = parser->serialize(views);
+    assert(parser->parse(serialized.data(), serialized.size()) == views);
+    std::cout << "incremental writer: OK" << std::endl;
+}
+
+#endif // PREGPARSER_TEST_WRITER